@@ -0,0 +1,74 @@
+{
+    'targets': [
+        {
+            'target_name': 'class_inheritance',
+            'includes': ['../naah.gypi', '../test/except.gypi'],
+            'sources': ['class_inheritance.cc']
+        },
+        {
+            'target_name': 'exports_load',
+            'includes': ['../naah.gypi', '../test/except.gypi'],
+            'sources': ['exports_load.cc']
+        },
+        {
+            'target_name': 'worker_scaling',
+            'includes': ['../naah.gypi', '../test/except.gypi'],
+            'sources': ['worker_scaling.cc']
+        },
+        {
+            'target_name': 'string_args',
+            'includes': ['../naah.gypi', '../test/except.gypi'],
+            'sources': ['string_args.cc']
+        },
+        {
+            'target_name': 'enum_strings',
+            'includes': ['../naah.gypi', '../test/except.gypi'],
+            'sources': ['enum_strings.cc']
+        },
+        {
+            'target_name': 'enum_strings_refs',
+            'includes': ['../naah.gypi', '../test/except.gypi'],
+            'sources': ['enum_strings.cc'],
+            # runtimes reference strings for modules targeting Node-API 10+
+            'defines': [
+                'NAPI_EXPERIMENTAL',
+                'NODE_API_EXPERIMENTAL_BASIC_ENV_OPT_OUT'
+            ]
+        },
+        {
+            'target_name': 'collections',
+            'includes': ['../naah.gypi', '../test/except.gypi'],
+            'sources': ['collections.cc']
+        },
+        {
+            'target_name': 'variant_args',
+            'includes': ['../naah.gypi', '../test/except.gypi'],
+            'sources': ['variant_args.cc']
+        },
+        {
+            'target_name': 'large_strings',
+            'includes': ['../naah.gypi', '../test/except.gypi'],
+            'sources': ['large_strings.cc']
+        },
+        {
+            'target_name': 'large_strings_external',
+            'includes': ['../naah.gypi', '../test/except.gypi'],
+            'sources': ['large_strings.cc'],
+            # external strings are experimental before Node-API 10
+            'defines': [
+                'NAPI_EXPERIMENTAL',
+                'NODE_API_EXPERIMENTAL_BASIC_ENV_OPT_OUT'
+            ]
+        },
+        {
+            'target_name': 'fast_calls',
+            'includes': ['../naah.gypi', '../test/except.gypi'],
+            'sources': ['fast_calls.cc']
+        },
+        {
+            'target_name': 'scalar_args',
+            'includes': ['../naah.gypi', '../test/except.gypi'],
+            'sources': ['scalar_args.cc']
+        }
+    ]
+}
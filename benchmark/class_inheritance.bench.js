@@ -0,0 +1,17 @@
+const { load, bench } = require('./common')
+
+const binding = load('class_inheritance')
+
+bench('return instance', () => binding.Level0.create(0))
+bench('return 16 instances', () => binding.Level0.createMany(16))
+
+for (let depth = 0; depth <= 4; ++depth) {
+  const Level = binding[`Level${depth}`]
+  const obj = new Level(0)
+  bench(`depth ${depth}: new`, () => new Level(0))
+  bench(`depth ${depth}: base method`, () => obj.base())
+  bench(`depth ${depth}: base accessor`, () => obj.num)
+  if (depth > 0) {
+    bench(`depth ${depth}: own method`, () => obj.own())
+  }
+}
@@ -0,0 +1,75 @@
+#include <naah.h>
+
+#include <vector>
+
+namespace {
+class Level0 : public naah::Class {
+ public:
+  Level0(uint32_t num) : _num(num) {}
+
+  uint32_t num() const { return _num; }
+  uint32_t Base() { return ++_num; }
+
+  // instances returned by value are wrapped by the constructor of their class
+  static Level0 Create(uint32_t num) { return Level0(num); }
+  static std::vector<Level0> CreateMany(uint32_t count) {
+    return std::vector<Level0>(count, Level0(0));
+  }
+
+ protected:
+  uint32_t _num;
+};
+
+class Level1 : public Level0 {
+ public:
+  Level1(uint32_t num) : Level0(num) {}
+  uint32_t Own() { return ++_num; }
+};
+
+class Level2 : public Level1 {
+ public:
+  Level2(uint32_t num) : Level1(num) {}
+  uint32_t Own() { return ++_num; }
+};
+
+class Level3 : public Level2 {
+ public:
+  Level3(uint32_t num) : Level2(num) {}
+  uint32_t Own() { return ++_num; }
+};
+
+class Level4 : public Level3 {
+ public:
+  Level4(uint32_t num) : Level3(num) {}
+  uint32_t Own() { return ++_num; }
+};
+}  // namespace
+
+NAAH_REGISTRATION {
+  using reg = naah::Registration;
+
+  reg::Class<Level0>("Level0")
+      .Constructor<uint32_t>()
+      .InstanceMethod<&Level0::Base>("base")
+      .InstanceAccessor<&Level0::num>("num")
+      .StaticMethod<&Level0::Create>("create")
+      .StaticMethod<&Level0::CreateMany>("createMany");
+  reg::Class<Level1>("Level1")
+      .Inherits<Level0>()
+      .Constructor<uint32_t>()
+      .InstanceMethod<&Level1::Own>("own");
+  reg::Class<Level2>("Level2")
+      .Inherits<Level1>()
+      .Constructor<uint32_t>()
+      .InstanceMethod<&Level2::Own>("own");
+  reg::Class<Level3>("Level3")
+      .Inherits<Level2>()
+      .Constructor<uint32_t>()
+      .InstanceMethod<&Level3::Own>("own");
+  reg::Class<Level4>("Level4")
+      .Inherits<Level3>()
+      .Constructor<uint32_t>()
+      .InstanceMethod<&Level4::Own>("own");
+}
+
+NAAH_EXPORT
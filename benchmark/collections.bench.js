@@ -0,0 +1,20 @@
+const { load, bench } = require('./common')
+
+const binding = load('collections')
+
+for (const [size, iterations] of [[1000, 1000], [100000, 10]]) {
+  binding.fill(size)
+  const obj = binding.getStrings()
+  const map = binding.getNumbers()
+  const set = binding.getSet()
+  const run = (name, fn) => bench(`${size} entries: ${name}`, fn, iterations)
+  run('object -> map, by hand', () => binding.takeStringsByHand(obj))
+  run('object -> map', () => binding.takeStrings(obj))
+  run('map -> object, by hand', () => binding.getStringsByHand())
+  run('map -> object', () => binding.getStrings())
+  run('Map -> map', () => binding.takeNumbers(map))
+  run('map -> Map, by hand', () => binding.getNumbersByHand())
+  run('map -> Map', () => binding.getNumbers())
+  run('Set -> set', () => binding.takeSet(set))
+  run('set -> Set', () => binding.getSet())
+}
@@ -0,0 +1,91 @@
+#include <naah.h>
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace {
+using StringMap = std::unordered_map<std::string, double>;
+using NumberMap = std::unordered_map<uint32_t, double>;
+
+StringMap &Strings() {
+  static StringMap map;
+  return map;
+}
+
+NumberMap &Numbers() {
+  static NumberMap map;
+  return map;
+}
+
+void Fill(uint32_t count) {
+  Strings().clear();
+  Numbers().clear();
+  for (uint32_t i = 0; i < count; i++) {
+    Strings().emplace("key" + std::to_string(i), i);
+    Numbers().emplace(i, i);
+  }
+}
+
+StringMap GetStrings() { return Strings(); }
+NumberMap GetNumbers() { return Numbers(); }
+std::unordered_set<uint32_t> GetSet() {
+  std::unordered_set<uint32_t> set;
+  for (auto &entry : Numbers()) {
+    set.insert(entry.first);
+  }
+  return set;
+}
+
+size_t TakeStrings(StringMap map) { return map.size(); }
+size_t TakeNumbers(NumberMap map) { return map.size(); }
+size_t TakeSet(std::unordered_set<uint32_t> set) { return set.size(); }
+
+// what addons write without the transformers
+Napi::Value GetStringsByHand(const Napi::CallbackInfo &info) {
+  Napi::Object obj = Napi::Object::New(info.Env());
+  for (auto &[key, value] : Strings()) {
+    obj.Set(key, value);
+  }
+  return obj;
+}
+
+Napi::Value GetNumbersByHand(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  Napi::Object map =
+      env.Global().Get("Map").As<Napi::Function>().New({}).As<Napi::Object>();
+  Napi::Function set = map.Get("set").As<Napi::Function>();
+  for (auto &[key, value] : Numbers()) {
+    set.Call(map, {Napi::Number::New(env, key), Napi::Number::New(env, value)});
+  }
+  return map;
+}
+
+size_t TakeStringsByHand(Napi::Object obj) {
+  Napi::Array keys = obj.GetPropertyNames();
+  StringMap map;
+  for (uint32_t i = 0; i < keys.Length(); i++) {
+    Napi::Value key = keys.Get(i);
+    map.emplace(key.As<Napi::String>().Utf8Value(),
+                obj.Get(key).As<Napi::Number>().DoubleValue());
+  }
+  return map.size();
+}
+}  // namespace
+
+NAAH_REGISTRATION {
+  using reg = naah::Registration;
+
+  reg::Function<Fill>("fill");
+  reg::Function<GetStrings>("getStrings");
+  reg::Function<GetNumbers>("getNumbers");
+  reg::Function<GetSet>("getSet");
+  reg::Function<TakeStrings>("takeStrings");
+  reg::Function<TakeNumbers>("takeNumbers");
+  reg::Function<TakeSet>("takeSet");
+  reg::Function<GetStringsByHand>("getStringsByHand");
+  reg::Function<GetNumbersByHand>("getNumbersByHand");
+  reg::Function<TakeStringsByHand>("takeStringsByHand");
+}
+
+NAAH_EXPORT
@@ -0,0 +1,11 @@
+const bindings = require('bindings')
+
+exports.load = name => bindings(`${name}.node`)
+
+exports.bench = (name, fn, iterations = 1e6) => {
+  for (let i = 0; i < Math.min(iterations, 1e4); ++i) fn(i)
+  const start = process.hrtime.bigint()
+  for (let i = 0; i < iterations; ++i) fn(i)
+  const ns = Number(process.hrtime.bigint() - start)
+  console.log(`  ${name.padEnd(48)} ${(ns / iterations).toFixed(1).padStart(10)} ns/op`)
+}
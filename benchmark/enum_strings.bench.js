@@ -0,0 +1,13 @@
+const { load, bench } = require('./common')
+
+for (const name of ['enum_strings', 'enum_strings_refs']) {
+  const binding = load(name)
+  bench(`${name}: return const char *`, () => binding.chars())
+  bench(`${name}: return InternedString`, () => binding.interned())
+  bench(`${name}: return Enum`, () => binding.enum())
+  const literal = 'running'
+  bench(`${name}: std::string -> const char *`, () => binding.nextChars(literal))
+  bench(`${name}: Enum -> Enum, literal`, () => binding.nextEnum(literal))
+  const returned = binding.enum()
+  bench(`${name}: Enum -> Enum, returned`, () => binding.nextEnum(returned))
+}
@@ -0,0 +1,55 @@
+#include <naah.h>
+
+namespace {
+enum class Status { kIdle, kRunning, kDone, kFailed };
+
+const char *StatusName(Status status) {
+  switch (status) {
+    case Status::kIdle:
+      return "idle";
+    case Status::kRunning:
+      return "running";
+    case Status::kDone:
+      return "done";
+    default:
+      return "failed";
+  }
+}
+
+Status Next(Status status) {
+  return static_cast<Status>((static_cast<int>(status) + 1) % 4);
+}
+
+const char *NextChars(std::string name) {
+  for (int i = 0; i < 4; ++i) {
+    if (name == StatusName(static_cast<Status>(i))) {
+      return StatusName(Next(static_cast<Status>(i)));
+    }
+  }
+  return "";
+}
+
+naah::InternedString Interned() { return NAAH_INTERNED_STRING("running"); }
+}  // namespace
+
+namespace naah {
+template <>
+struct Enum<Status> {
+  static constexpr EnumValue<Status> values[] = {{Status::kIdle, "idle"},
+                                                 {Status::kRunning, "running"},
+                                                 {Status::kDone, "done"},
+                                                 {Status::kFailed, "failed"}};
+};
+}  // namespace naah
+
+NAAH_REGISTRATION {
+  using reg = naah::Registration;
+
+  reg::Function("chars", []() { return StatusName(Status::kRunning); });
+  reg::Function<Interned>("interned");
+  reg::Function("enum", []() { return Status::kRunning; });
+  reg::Function<NextChars>("nextChars");
+  reg::Function<Next>("nextEnum");
+}
+
+NAAH_EXPORT
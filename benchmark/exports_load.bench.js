@@ -0,0 +1,25 @@
+const { execFileSync } = require('child_process')
+const path = require('path')
+
+// a module is only initialized once per process, measure in fresh ones
+const measure = (name, target, body, runs = 30) => {
+  const common = JSON.stringify(path.join(__dirname, 'common'))
+  const script = `
+    const { load } = require(${common})
+    const start = process.hrtime.bigint()
+    const binding = load('${target}')
+    ${body}
+    console.log(Number(process.hrtime.bigint() - start))`
+  const samples = []
+  for (let i = 0; i < runs; ++i) {
+    samples.push(Number(execFileSync(process.execPath, ['-e', script])))
+  }
+  samples.sort((a, b) => a - b)
+  const ms = samples[samples.length >> 1] / 1e6
+  console.log(`  ${name.padEnd(48)} ${ms.toFixed(2).padStart(10)} ms`)
+}
+
+measure('load 5000 exports', 'exports_load', '')
+measure('load and call 1 export', 'exports_load', 'binding.fn0(1)')
+measure('load and call all exports', 'exports_load',
+  'for (let i = 0; i < 5000; ++i) binding[`fn${i}`](1)')
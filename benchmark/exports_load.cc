@@ -0,0 +1,27 @@
+#include <naah.h>
+
+#include <string>
+#include <vector>
+
+namespace {
+constexpr size_t kExports = 5000;
+
+std::vector<std::string> &Names() {
+  static std::vector<std::string> names;
+  return names;
+}
+}  // namespace
+
+NAAH_REGISTRATION {
+  using reg = naah::Registration;
+
+  std::vector<std::string> &names = Names();
+  names.reserve(kExports);
+  for (size_t i = 0; i < kExports; ++i) {
+    names.push_back("fn" + std::to_string(i));
+    reg::Function(names.back().c_str(),
+                  [](uint32_t a) -> uint32_t { return a + 1; });
+  }
+}
+
+NAAH_EXPORT
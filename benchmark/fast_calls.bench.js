@@ -0,0 +1,12 @@
+const { load, bench } = require('./common')
+
+const binding = load('fast_calls')
+
+bench('add(uint32, uint32)', i => binding.add(i, 1))
+bench('add(uint32, uint32) fast', i => binding.addFast(i, 1))
+bench('(double, double, uint32, int32, bool)', () =>
+  binding.scalars(1.5, 2, 3, -4, true)
+)
+bench('(double, double, uint32, int32, bool) fast', () =>
+  binding.scalarsFast(1.5, 2, 3, -4, true)
+)
@@ -0,0 +1,20 @@
+#include <naah.h>
+
+namespace {
+uint32_t Add(uint32_t a, uint32_t b) { return a + b; }
+
+double Scalars(double a, double b, uint32_t c, int32_t d, bool e) {
+  return e ? a + b + c + d : a - b;
+}
+}  // namespace
+
+NAAH_REGISTRATION {
+  using reg = naah::Registration;
+
+  reg::Function<Add>("add");
+  reg::FastFunction<Add>("addFast");
+  reg::Function<Scalars>("scalars");
+  reg::FastFunction<Scalars>("scalarsFast");
+}
+
+NAAH_EXPORT
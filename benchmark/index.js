@@ -0,0 +1,11 @@
+const fs = require('fs')
+const path = require('path')
+
+const filter = process.argv[2]
+
+for (const file of fs.readdirSync(__dirname).sort()) {
+  if (!file.endsWith('.bench.js')) continue
+  if (filter && !file.includes(filter)) continue
+  console.log(file.replace('.bench.js', ''))
+  require(path.join(__dirname, file))
+}
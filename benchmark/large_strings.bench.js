@@ -0,0 +1,19 @@
+const { load, bench } = require('./common')
+
+// the same functions, copying and with external strings (Node-API 10)
+const copying = load('large_strings')
+const external = load('large_strings_external')
+
+for (const [label, size, iterations] of [
+  ['1 KB', 1 << 10, 1e5],
+  ['1 MB', 1 << 20, 200],
+  ['64 MB', 64 << 20, 5]
+]) {
+  copying.prepare(size)
+  external.prepare(size)
+  bench(`${label} ascii: std::string`, () => copying.asciiString(), iterations)
+  bench(`${label} ascii: copied ExternalString`, () => copying.asciiExternal(), iterations)
+  bench(`${label} ascii: ExternalString`, () => external.asciiExternal(), iterations)
+  bench(`${label} utf16: std::u16string`, () => copying.utf16String(), iterations)
+  bench(`${label} utf16: ExternalString`, () => external.utf16External(), iterations)
+}
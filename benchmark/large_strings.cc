@@ -0,0 +1,41 @@
+#include <naah.h>
+
+#include <string>
+
+namespace {
+std::string &Ascii() {
+  static std::string str;
+  return str;
+}
+
+std::u16string &Utf16() {
+  static std::u16string str;
+  return str;
+}
+
+void Prepare(uint32_t size) {
+  Ascii().assign(size, 'x');
+  Utf16().assign(size / 2, u'你');
+}
+
+// a new string per call, like a serializer would produce
+std::string AsciiString() { return Ascii(); }
+
+naah::ExternalString<> AsciiExternal() { return Ascii(); }
+
+std::u16string Utf16String() { return Utf16(); }
+
+naah::ExternalString<std::u16string> Utf16External() { return Utf16(); }
+}  // namespace
+
+NAAH_REGISTRATION {
+  using reg = naah::Registration;
+
+  reg::Function<Prepare>("prepare");
+  reg::Function<AsciiString>("asciiString");
+  reg::Function<AsciiExternal>("asciiExternal");
+  reg::Function<Utf16String>("utf16String");
+  reg::Function<Utf16External>("utf16External");
+}
+
+NAAH_EXPORT
@@ -0,0 +1,11 @@
+const { load, bench } = require('./common')
+
+const binding = load('scalar_args')
+
+bench('(double, double, uint32, int32, bool)', () =>
+  binding.scalars(1.5, 2, 3, -4, true)
+)
+bench('(int64, uint64)', () => binding.int64s(1n, 2n))
+bench('(string, u16string)', () => binding.strings('abc', 'def'))
+bench('(Number, Number, Number)', () => binding.numbers(1, 2, 3))
+bench('Number | string, number', () => binding.variant(1))
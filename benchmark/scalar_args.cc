@@ -0,0 +1,31 @@
+#include <naah.h>
+
+#include <variant>
+
+namespace {
+double Scalars(double a, double b, uint32_t c, int32_t d, bool e) {
+  return e ? a + b + c + d : a - b;
+}
+
+double Int64s(int64_t a, uint64_t b) { return static_cast<double>(a + b); }
+
+size_t Strings(std::string a, std::u16string b) { return a.size() + b.size(); }
+
+size_t Numbers(Napi::Number a, Napi::Number b, Napi::Number c) {
+  return a.Int32Value() + b.Int32Value() + c.Int32Value();
+}
+
+size_t Variant(std::variant<Napi::Number, std::string> a) { return a.index(); }
+}  // namespace
+
+NAAH_REGISTRATION {
+  using reg = naah::Registration;
+
+  reg::Function<Scalars>("scalars");
+  reg::Function<Int64s>("int64s");
+  reg::Function<Strings>("strings");
+  reg::Function<Numbers>("numbers");
+  reg::Function<Variant>("variant");
+}
+
+NAAH_EXPORT
@@ -0,0 +1,11 @@
+const { load, bench } = require('./common')
+
+const binding = load('string_args')
+
+for (const size of [8, 64, 1024]) {
+  const key = 'k'.repeat(size)
+  binding.insert(key, size)
+  bench(`${size} chars: std::string`, () => binding.lookupString(key))
+  bench(`${size} chars: std::string_view`, () => binding.lookupView(key))
+  bench(`${size} chars: std::u16string_view`, () => binding.lookupU16View(key))
+}
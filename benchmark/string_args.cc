@@ -0,0 +1,38 @@
+#include <naah.h>
+
+#include <map>
+#include <string>
+
+namespace {
+std::map<std::string, uint32_t, std::less<>> &Table() {
+  static std::map<std::string, uint32_t, std::less<>> table;
+  return table;
+}
+
+uint32_t LookupString(std::string key) {
+  auto it = Table().find(key);
+  return it != Table().end() ? it->second : 0;
+}
+
+uint32_t LookupView(std::string_view key) {
+  auto it = Table().find(key);
+  return it != Table().end() ? it->second : 0;
+}
+
+uint32_t LookupU16View(std::u16string_view key) {
+  return static_cast<uint32_t>(key.size());
+}
+
+void Insert(std::string key, uint32_t value) { Table()[key] = value; }
+}  // namespace
+
+NAAH_REGISTRATION {
+  using reg = naah::Registration;
+
+  reg::Function<LookupString>("lookupString");
+  reg::Function<LookupView>("lookupView");
+  reg::Function<LookupU16View>("lookupU16View");
+  reg::Function<Insert>("insert");
+}
+
+NAAH_EXPORT
@@ -0,0 +1,10 @@
+const { load, bench } = require('./common')
+
+const binding = load('variant_args')
+
+const values = Array.from({ length: 1000 }, (_, i) => i)
+bench('vector | string, string', () => binding.vectorOrString('str'))
+bench('vector | string, 1k array', () => binding.vectorOrString(values), 1e4)
+bench('double | bool | string, string', () => binding.scalars('str'))
+const tagged = { values, tag: 1 }
+bench('Samples | Tagged, Tagged', () => binding.samplesOrTagged(tagged), 1e4)
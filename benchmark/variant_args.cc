@@ -0,0 +1,42 @@
+#include <naah.h>
+
+#include <variant>
+
+namespace {
+struct Samples : naah::Object {
+  std::vector<double> values;
+  std::string unit;
+};
+
+struct Tagged : naah::Object {
+  std::vector<double> values;
+  uint32_t tag;
+};
+
+size_t VectorOrString(std::variant<std::vector<double>, std::string> input) {
+  return input.index();
+}
+
+size_t Scalars(std::variant<double, bool, std::string> input) {
+  return input.index();
+}
+
+size_t SamplesOrTagged(std::variant<Samples, Tagged> input) {
+  return input.index();
+}
+}  // namespace
+
+NAAH_REGISTRATION {
+  using reg = naah::Registration;
+
+  reg::Object<Samples>()
+      .Member<&Samples::values>("values")
+      .Member<&Samples::unit>("unit");
+  reg::Object<Tagged>().Member<&Tagged::values>("values").Member<&Tagged::tag>(
+      "tag");
+  reg::Function<VectorOrString>("vectorOrString");
+  reg::Function<Scalars>("scalars");
+  reg::Function<SamplesOrTagged>("samplesOrTagged");
+}
+
+NAAH_EXPORT
@@ -0,0 +1,66 @@
+const os = require('os')
+const path = require('path')
+const { Worker, isMainThread, parentPort, workerData } =
+  require('worker_threads')
+
+const ops = {
+  'function call': binding => binding.add(1, 2),
+  'method call': (binding, counter) => counter.increase(),
+  'class instance to js': binding => binding.Counter.create(1)
+}
+
+if (isMainThread) {
+  const iterations = 1e6
+  const cores = os.availableParallelism ? os.availableParallelism() : os.cpus().length
+  const counts = [1, 2, 4, 8, 16].filter(n => n === 1 || n <= cores * 2)
+
+  const run = (op, count) => new Promise((resolve, reject) => {
+    const start = new Int32Array(new SharedArrayBuffer(4))
+    let ready = 0
+    let done = 0
+    let begin
+    const workers = []
+    for (let i = 0; i < count; ++i) {
+      const worker = new Worker(__filename,
+        { workerData: { op, iterations, start } })
+      worker.on('error', reject)
+      worker.on('message', message => {
+        if (message === 'ready' && ++ready === count) {
+          begin = process.hrtime.bigint()
+          Atomics.store(start, 0, 1)
+          Atomics.notify(start, 0)
+        } else if (message === 'done' && ++done === count) {
+          const ns = Number(process.hrtime.bigint() - begin)
+          workers.forEach(w => w.terminate())
+          resolve(count * iterations / ns * 1e3)
+        }
+      })
+      workers.push(worker)
+    }
+  })
+
+  ;(async () => {
+    console.log(`  ${cores} cores available`)
+    for (const op of Object.keys(ops)) {
+      let base
+      for (const count of counts) {
+        const mops = await run(op, count)
+        base = base || mops
+        console.log(`  ${`${op}, ${count} workers`.padEnd(48)} ` +
+          `${mops.toFixed(2).padStart(10)} Mops/s ` +
+          `${(mops / base).toFixed(2).padStart(6)}x`)
+      }
+    }
+  })()
+} else {
+  const { load } = require(path.join(__dirname, 'common'))
+  const binding = load('worker_scaling')
+  const fn = ops[workerData.op]
+  const counter = new binding.Counter(0)
+  for (let i = 0; i < 1e4; ++i) fn(binding, counter)
+
+  parentPort.postMessage('ready')
+  Atomics.wait(workerData.start, 0, 0)
+  for (let i = 0; i < workerData.iterations; ++i) fn(binding, counter)
+  parentPort.postMessage('done')
+}
@@ -0,0 +1,30 @@
+#include <naah.h>
+
+namespace {
+uint32_t Add(uint32_t a, uint32_t b) { return a + b; }
+
+class Counter : public naah::Class {
+ public:
+  Counter(uint32_t num) : _num(num) {}
+
+  uint32_t Increase() { return ++_num; }
+
+  static Counter Create(uint32_t num) { return Counter(num); }
+
+ private:
+  uint32_t _num;
+};
+}  // namespace
+
+NAAH_REGISTRATION {
+  using reg = naah::Registration;
+
+  reg::Function<Add>("add");
+
+  reg::Class<Counter>("Counter")
+      .Constructor<uint32_t>()
+      .InstanceMethod<&Counter::Increase>("increase")
+      .StaticMethod<&Counter::Create>("create");
+}
+
+NAAH_EXPORT
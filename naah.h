@@ -3,11 +3,14 @@
 
 #include <napi.h>
 
+#include <atomic>
+#include <chrono>
 #include <functional>
-#include <map>
 #include <memory>
 #include <optional>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 
 namespace naah {
 
@@ -26,6 +29,39 @@ struct ValueTransformer {
   static Napi::Value ToJS(Napi::Env, T);
 };
 
+// JS types accepted by ValueTransformer<T>::FromJS. A transformer declares
+//   static constexpr JSType kJSType = JSType::kString;
+// to let std::variant skip it for values of other types, transformers
+// without it are always tried.
+enum class JSType : uint32_t {
+  kNone = 0,
+  kUndefined = 1 << 0,
+  kNull = 1 << 1,
+  kBoolean = 1 << 2,
+  kNumber = 1 << 3,
+  kString = 1 << 4,
+  kSymbol = 1 << 5,
+  kBigInt = 1 << 6,
+  kFunction = 1 << 7,
+  kExternal = 1 << 8,
+  kArray = 1 << 9,
+  kTypedArray = 1 << 10,
+  // objects other than arrays and typed arrays
+  kObject = 1 << 11,
+  kAnyObject = kArray | kTypedArray | kObject,
+  kAny = (1 << 12) - 1
+};
+
+constexpr JSType operator|(JSType a, JSType b) {
+  return static_cast<JSType>(static_cast<uint32_t>(a) |
+                             static_cast<uint32_t>(b));
+}
+
+constexpr JSType operator&(JSType a, JSType b) {
+  return static_cast<JSType>(static_cast<uint32_t>(a) &
+                             static_cast<uint32_t>(b));
+}
+
 template <typename Ret = void>
 class AsyncWork {
  public:
@@ -60,6 +96,17 @@ class ArrayBuffer : public std::vector<char> {
   using Super::Super;
 };
 
+// converts a std::map / std::unordered_map with string keys into a JS Map
+// instead of a plain object
+template <typename M>
+class JSMap : public M {
+ private:
+  using Super = M;
+
+ public:
+  using Super::Super;
+};
+
 template <typename E, napi_typedarray_type napi_type>
 class TypedArrayOf : public std::vector<E> {
  private:
@@ -81,8 +128,223 @@ using Float64Array = TypedArrayOf<double, napi_float64_array>;
 #if NAPI_VERSION > 5
 using BigUint64Array = TypedArrayOf<uint64_t, napi_biguint64_array>;
 using BigInt64Array = TypedArrayOf<int64_t, napi_bigint64_array>;
+
+// a 64-bit integer passed as a number if it's within Number.MAX_SAFE_INTEGER
+// and as a BigInt otherwise, arguments accept both
+template <typename T>
+class SafeInteger {
+ public:
+  SafeInteger(T value = 0) NAPI_NOEXCEPT;
+
+  operator T() const NAPI_NOEXCEPT;
+
+ private:
+  T _value;
+};
+
+using SafeInt64 = SafeInteger<int64_t>;
+using SafeUint64 = SafeInteger<uint64_t>;
 #endif
 
+// elements of a trivially copyable registered object T, passed as a single
+// ArrayBuffer of size() * sizeof(T) bytes. Arguments also accept typed
+// arrays and DataViews. JS reads the elements as described by
+// StructLayout<T>.
+template <typename T>
+class StructArray : public std::vector<T> {
+ private:
+  using Super = std::vector<T>;
+
+  static_assert(std::is_trivially_copyable_v<T>,
+                "StructArray elements must be trivially copyable");
+
+ public:
+  using Super::Super;
+};
+
+// converts into the layout of T in a StructArray<T>:
+//   { stride, littleEndian, fields: { name: { offset, type } } }
+// where type names the DataView accessor of a field, e.g. 'Float32' for
+// getFloat32. Only members of arithmetic types are described.
+template <typename T>
+struct StructLayout {};
+
+// a std::string or std::u16string handed over to JS when returned instead
+// of being copied, for large strings. UTF-16 and ASCII strings become
+// external strings, other UTF-8 is copied. Strings are copied as well
+// (ASCII ones without decoding) unless the module targets Node-API 10, or
+// NAPI_EXPERIMENTAL with headers declaring experimental external strings.
+template <typename S = std::string>
+class ExternalString : public S {
+ private:
+  using Super = S;
+
+ public:
+  using Super::Super;
+
+  ExternalString(S str) : Super(std::move(str)) {}
+};
+
+namespace details {
+class SharedMemory;
+}
+
+// memory of a SharedArrayBuffer, read by JS while native threads write it.
+// Copies share the memory and are safe to capture into AsyncWork tasks and
+// thread-safe callbacks, the SharedArrayBuffer is kept alive until the last
+// one is destroyed in any thread, or until its env is torn down. Copies
+// outliving the env keep working on a copy of the memory, which they own:
+// only pointers taken from data() before must not be used anymore, see
+// StopToken. Converts back into the same SharedArrayBuffer, in the env it
+// came from. Binding a SharedArrayBuffer which is bound already reuses it.
+class SharedBuffer {
+ public:
+  SharedBuffer() = default;
+
+  // creates a SharedArrayBuffer of size bytes, on the JS thread
+  static SharedBuffer New(Napi::Env env, size_t size);
+
+  char *data() const NAPI_NOEXCEPT;
+  size_t size() const NAPI_NOEXCEPT;
+
+  // Atomics.load / Atomics.store of the int32 at byte offset index * 4,
+  // failing if it's out of bounds or misaligned
+  std::optional<int32_t> Load(size_t index) const NAPI_NOEXCEPT;
+  bool Store(size_t index, int32_t value) const NAPI_NOEXCEPT;
+
+  // Atomics.notify on the int32 at index, from any thread. Wakes JS waiting
+  // with Atomics.waitAsync, notifications pending on the JS thread are
+  // coalesced into a single call.
+  void Notify(size_t index) const;
+
+ private:
+  explicit SharedBuffer(std::shared_ptr<details::SharedMemory> memory);
+
+  // nullptr if the int32 at index is out of bounds or misaligned
+  std::atomic<int32_t> *Int32At(char *data, size_t index) const NAPI_NOEXCEPT;
+
+  // binds a SharedArrayBuffer, or creates one of size bytes for undefined
+  static std::optional<SharedBuffer> Bind(Napi::Env env, Napi::Value buffer,
+                                          size_t size);
+
+  std::shared_ptr<details::SharedMemory> _memory;
+
+  friend struct ValueTransformer<SharedBuffer>;
+};
+
+template <typename T>
+class Out;
+
+// a typed array for results, the one passed by the caller to reuse it across
+// calls or a new one when undefined is passed. Returning it returns that same
+// typed array. Like Napi values, it's only valid until the function returns.
+template <typename E, napi_typedarray_type type>
+class Out<TypedArrayOf<E, type>> {
+ public:
+  E *data() const NAPI_NOEXCEPT;
+  size_t size() const NAPI_NOEXCEPT;
+  E &operator[](size_t index) const NAPI_NOEXCEPT;
+
+  // makes the typed array hold length elements: creates it when the caller
+  // passed undefined, fails for a caller's array of another length
+  bool Resize(size_t length);
+
+ private:
+  explicit Out(Napi::Env env) NAPI_NOEXCEPT;
+
+  Napi::Env _env;
+  napi_value _value = nullptr;
+  E *_data = nullptr;
+  size_t _size = 0;
+
+  friend struct ValueTransformer<Out>;
+};
+
+// an argument converted the first time it's read, so that a function which
+// returns early doesn't pay for converting a large one. Only the type of the
+// value is checked when the function is called. Like Napi values, it's only
+// valid until the function returns.
+template <typename T>
+class Lazy {
+ public:
+  // the converted value, empty if the argument isn't a T, converted once
+  std::optional<T> &get();
+
+  Napi::Value value() const NAPI_NOEXCEPT;
+
+ private:
+  explicit Lazy(Napi::Value value) NAPI_NOEXCEPT;
+
+  Napi::Value _value;
+  std::optional<std::optional<T>> _converted;
+
+  friend struct ValueTransformer<Lazy>;
+};
+
+namespace details {
+class CallArena;
+template <typename T>
+struct ContextOf;
+template <bool kEnabled>
+struct CallStatsScope;
+}  // namespace details
+
+// Context parameters are supplied by naah instead of JS arguments, anywhere
+// in the parameters of a function: Napi::Env, CallArena &, CallStats & and
+// StopToken.
+
+// scratch memory of the call, released when it returns. Allocate<T>(count)
+// returns uninitialized memory for trivially destructible temporaries.
+using CallArena = details::CallArena;
+
+// timing of the current call
+class CallStats {
+ public:
+  CallStats(const CallStats &) = delete;
+  CallStats &operator=(const CallStats &) = delete;
+  ~CallStats();
+
+  // arguments passed by JS
+  size_t argc() const NAPI_NOEXCEPT;
+  // since the call started, before its arguments were converted
+  std::chrono::nanoseconds Elapsed() const NAPI_NOEXCEPT;
+  // spent converting the arguments
+  std::chrono::nanoseconds conversion() const NAPI_NOEXCEPT;
+
+ private:
+  explicit CallStats(size_t argc) NAPI_NOEXCEPT;
+
+  static CallStats *Current() NAPI_NOEXCEPT;
+
+  size_t _argc;
+  std::chrono::steady_clock::time_point _start;
+  std::chrono::steady_clock::duration _conversion{};
+  CallStats *_previous;
+  static inline thread_local CallStats *_current = nullptr;
+
+  friend struct details::ContextOf<CallStats>;
+  friend struct details::CallStatsScope<true>;
+};
+
+// stopped once the env is torn down, when its worker is terminated or the
+// process exits, for long work to give up. Copies are safe to use in any
+// thread. A default constructed token (or one of an env without a
+// Registration) is never stopped.
+class StopToken {
+ public:
+  StopToken() = default;
+
+  bool stop_requested() const NAPI_NOEXCEPT;
+
+ private:
+  explicit StopToken(std::shared_ptr<const std::atomic<bool>> stopped)
+      NAPI_NOEXCEPT;
+
+  std::shared_ptr<const std::atomic<bool>> _stopped;
+
+  friend struct details::ContextOf<StopToken>;
+};
+
 class Error
 #ifdef NAPI_CPP_EXCEPTIONS
     : public std::exception
@@ -114,9 +376,40 @@ class TypeError : public Error {
   using Error::Error;
 };
 
+// Specialize Enum<E> to convert the enumerators of E from and into JS strings:
+//   static constexpr EnumValue<E> values[] = {{E::kFoo, "foo"}, ...};
+template <typename E>
+struct EnumValue {
+  E value;
+  std::string_view name;
+};
+
+template <typename E>
+struct Enum {};
+
+// a constant string whose JS value is created once per env, written as
+// NAAH_INTERNED_STRING("literal") and returned by value. Each expression
+// reserves its slot when the library is loaded.
+class InternedString {
+ public:
+  std::string_view str() const NAPI_NOEXCEPT;
+  size_t slot() const NAPI_NOEXCEPT;
+
+  // one slot per type of the lambda returning the literal
+  template <typename Literal>
+  static InternedString Of(Literal literal) NAPI_NOEXCEPT;
+
+ private:
+  InternedString(std::string_view str, size_t slot) NAPI_NOEXCEPT;
+
+  std::string_view _str;
+  size_t _slot;
+};
+
 struct ClassMetaInfo;
 namespace details {
 class ScriptWrappable;
+class ClassCache;
 }
 
 class Class {
@@ -127,6 +420,7 @@ class Class {
 
  public:
   using ConstructFn = std::unique_ptr<Class> (*)(const Napi::CallbackInfo &);
+  using ExternalMemoryFn = size_t (*)(Class &);
 
   Class();
   virtual ~Class();
@@ -135,10 +429,16 @@ class Class {
 };
 
 struct ClassMetaInfo {
+  static constexpr size_t kInvalidId = static_cast<size_t>(-1);
+
   const char *name;
   ClassMetaInfo *parent;
   Class::ConstructFn ctor;
   std::vector<napi_property_descriptor> descriptors;
+  // dense index into the per-env constructor table, assigned on registration
+  size_t id;
+  // native memory held by an instance, reported to GC while it's wrapped
+  Class::ExternalMemoryFn external_memory;
 };
 
 template <typename T>
@@ -152,6 +452,9 @@ class ClassRegistration {
   template <typename P>
   ClassRegistration<T> &Inherits();
 
+  template <auto T::*fn>
+  ClassRegistration<T> &ExternalMemory();
+
   template <auto T::*fn>
   ClassRegistration<T> &InstanceMethod(
       const char *name, napi_property_attributes attributes = napi_default,
@@ -192,6 +495,50 @@ class ObjectRegistration {
   ObjectRegistration Member(const char *name);
 };
 
+namespace details {
+// handles cached by naah, one block per env owned by its Registration
+struct EnvState {
+  // constructors indexed by ClassMetaInfo::id
+  std::vector<Napi::FunctionReference> classes;
+  // Reflect.construct, subclass instances are built by their base class
+  Napi::FunctionReference reflect_construct;
+  // the subclass being built by its base class constructor, if any, kept
+  // per thread so plain constructors don't look up the EnvState
+  static inline thread_local ClassMetaInfo *constructing = nullptr;
+  Napi::ObjectReference exports;
+  // interned strings indexed by slot, unused if the runtime can't reference
+  // strings (before Node-API 10)
+  std::vector<Napi::Reference<Napi::Value>> strings;
+  bool string_refs = true;
+  // JS helpers viewing and notifying SharedArrayBuffers
+  Napi::ObjectReference shared_buffer_helpers;
+  // SharedBuffers by the address of their memory, reused while a copy is
+  // alive, expired ones are swept as it grows
+  std::unordered_map<const void *, std::weak_ptr<SharedMemory>> shared_buffers;
+  size_t shared_buffers_sweep = 16;
+  // set when the env is torn down, read by StopTokens
+  std::shared_ptr<std::atomic<bool>> stopped =
+      std::make_shared<std::atomic<bool>>(false);
+
+  ~EnvState() { *stopped = true; }
+
+  // nullptr if the env has no Registration. Each lookup is a
+  // napi_get_instance_data call: plain function and method calls never make
+  // it, interned strings, enums, StopTokens and SharedBuffers make it per
+  // conversion, returned classes once per call through ClassCache.
+  static EnvState *Of(Napi::Env env);
+
+  // a string created each time instead of cached
+  static constexpr size_t kNoSlot = static_cast<size_t>(-1);
+
+  // slots for strings interned by any addon in the process
+  static size_t ReserveStrings(size_t count);
+  static Napi::Value String(Napi::Env env, size_t slot, std::string_view str);
+  // empty if the env has no Registration
+  static Napi::Function SharedBufferHelper(Napi::Env env, uint32_t index);
+};
+}  // namespace details
+
 class Registration : public Napi::Addon<Registration> {
  public:
   template <typename T>
@@ -204,21 +551,42 @@ class Registration : public Napi::Addon<Registration> {
   static void Function(const char *name, Callable callable,
                        void *data = nullptr);
 
+  // calls fn over many argument tuples in a single call from JavaScript
+  template <auto fn>
+  static void BatchFunction(const char *name, void *data = nullptr);
+
+  // fn only takes and returns numbers and booleans, its arguments are
+  // passed through memory of the function instead of being converted
+  template <auto fn>
+  static void FastFunction(const char *name);
+
   template <typename T>
   static ClassRegistration<T> Class(const char *name);
 
   template <typename T>
   static ObjectRegistration<T> Object();
 
+  // defer defining classes until their export is read or one of their
+  // instances is returned to JavaScript
+  static void LazyClasses();
+
   Registration(Napi::Env env, Napi::Object exports);
 
   template <typename T>
   Napi::Function FindClass();
 
  private:
-  std::map<ClassMetaInfo *, Napi::FunctionReference> classes_;
-  void DefineClass(Napi::Env env, ClassMetaInfo *meta_info,
-                   Napi::Object exports);
+  details::EnvState state_;
+  friend struct details::EnvState;
+  friend class details::ClassCache;
+
+  Napi::Function ClassOf(ClassMetaInfo *meta_info);
+  static napi_value LazyClassGetter(napi_env env, napi_callback_info cb_info);
+  void Export(Napi::Env env, const char *name, napi_value value);
+  void DefineClass(Napi::Env env, ClassMetaInfo *meta_info);
+  Napi::Function DefineSubclass(Napi::Env env, ClassMetaInfo *meta_info);
+  static napi_value ConstructSubclass(napi_env env,
+                                      napi_callback_info cb_info);
 };
 
 }  // namespace naah
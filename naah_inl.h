@@ -1,11 +1,30 @@
 #ifndef SRC_NAAH_INL_H_
 #define SRC_NAAH_INL_H_
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <set>
 #include <string_view>
+#include <thread>
 #include <tuple>
 #include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
 #include <variant>
 
+// node_api_create_external_string_*, experimental before Node-API 10, see
+// js_native_api.h. Headers predating them with NAPI_EXPERIMENTAL need an
+// explicit NAPI_VERSION below 10.
+#if defined(NODE_API_EXPERIMENTAL_HAS_EXTERNAL_STRINGS) || NAPI_VERSION >= 10
+#define NAAH_EXTERNAL_STRINGS
+#endif
+
 namespace naah {
 
 namespace details {
@@ -82,49 +101,108 @@ struct get_tuple_elements<std::tuple<Head, Rest...>> {
 };
 
 template <typename T>
-class ArgsConverter;
+using remove_cvref_t = std::remove_cv_t<std::remove_reference_t<T>>;
 
-template <>
-class ArgsConverter<std::tuple<>> {
- public:
-  template <typename Args>
-  static std::optional<std::tuple<>> Get(Args &&, size_t) {
-    return std::tuple<>();
+// how a context parameter of type T is supplied, see CallArena below
+template <typename T>
+struct ContextOf;
+
+template <typename T, typename Enable = void>
+struct is_context : std::false_type {};
+
+template <typename T>
+struct is_context<T, std::void_t<typename ContextOf<T>::Storage>>
+    : std::true_type {};
+
+template <typename T>
+struct ArgOf {
+  using Storage = std::optional<T>;
+};
+
+// arguments converted for a call, each one constructed in place from what
+// its transformer returned, then bound to its parameter: references bind to
+// the stored value and by-value parameters are moved from it. Context
+// parameters take no JS value.
+template <typename... Args>
+struct ArgsStorage {
+  template <typename Values>
+  static ArgsStorage Convert(Values &&, size_t, bool &) {
+    return {};
   }
 };
 
 template <typename Head, typename... Rest>
-class ArgsConverter<std::tuple<Head, Rest...>> {
- public:
-  template <typename Args>
-  static std::optional<std::tuple<Head, Rest...>> Get(Args &&args, size_t i) {
-    using Real = typename remove_optional<Head>::type;
-
-    std::optional<Real> opt_head = ValueTransformer<Real>::FromJS(args[i]);
+struct ArgsStorage<Head, Rest...> {
+  using Value = typename remove_optional<remove_cvref_t<Head>>::type;
+  static constexpr bool kOptional = is_optional<remove_cvref_t<Head>>::value;
+  static constexpr bool kContext = is_context<remove_cvref_t<Head>>::value;
+  using Storage = typename std::conditional_t<kContext, ContextOf<Value>,
+                                              ArgOf<Value>>::Storage;
+
+  Storage head;
+  ArgsStorage<Rest...> rest;
+
+  // converts values[i], values[i + 1], ... in order, stopping at the first
+  // required argument failing which clears ok
+  template <typename Values>
+  static ArgsStorage Convert(Values &&values, size_t i, bool &ok) {
+    if constexpr (kContext) {
+      return {ContextOf<Value>::Get(values.Env()),
+              ArgsStorage<Rest...>::Convert(values, i, ok)};
+    } else {
+      return {ConvertHead(values[i], ok),
+              ArgsStorage<Rest...>::Convert(values, i + 1, ok)};
+    }
+  }
 
-    if constexpr (!is_optional<Head>::value) {
-      if (!opt_head.has_value()) {
-        return {};
+  template <size_t I>
+  decltype(auto) Get() {
+    if constexpr (I > 0) {
+      return rest.template Get<I - 1>();
+    } else if constexpr (kContext) {
+      if constexpr (std::is_pointer_v<Storage>) {
+        return *head;
+      } else if constexpr (std::is_lvalue_reference_v<Head>) {
+        return (head);
+      } else {
+        return std::move(head);
+      }
+    } else if constexpr (kOptional) {
+      if constexpr (std::is_lvalue_reference_v<Head>) {
+        return (head);
+      } else {
+        return std::move(head);
+      }
+    } else {
+      if constexpr (std::is_lvalue_reference_v<Head>) {
+        return *head;
+      } else {
+        return std::move(*head);
       }
     }
+  }
 
-    std::optional<std::tuple<Rest...>> rest =
-        ArgsConverter<std::tuple<Rest...>>::Get(std::forward<Args>(args),
-                                                i + 1);
-    if (!rest.has_value()) {
-      return {};
-    }
+ private:
+  // a single return each so that the result is constructed in place
+  static std::optional<Value> ConvertHead(Napi::Value value, bool &ok) {
+    return ok ? FromJS(value, ok) : std::nullopt;
+  }
 
-    if constexpr (is_optional<Head>::value) {
-      return std::tuple_cat(std::make_tuple(std::move(opt_head)),
-                            std::move(*rest));
-    } else {
-      return std::tuple_cat(std::make_tuple(std::move(*opt_head)),
-                            std::move(*rest));
-    }
+  static std::optional<Value> FromJS(Napi::Value value, bool &ok) {
+    std::optional<Value> result = ValueTransformer<Value>::FromJS(value);
+    ok = kOptional || result.has_value();
+    return result;
   }
 };
 
+template <typename T>
+struct args_storage;
+
+template <typename... Args>
+struct args_storage<std::tuple<Args...>> {
+  typedef ArgsStorage<Args...> type;
+};
+
 template <typename T, typename Enable = void>
 struct is_result : std::false_type {};
 
@@ -140,38 +218,512 @@ struct result_type<Result<T_, E_>> {
   typedef E_ E;
 };
 
+// lets GC account for native memory owned by JavaScript values
+inline void AdjustExternalMemory(napi_env env, int64_t change) {
+  if (change != 0) {
+    int64_t adjusted_value;
+    napi_adjust_external_memory(env, change, &adjusted_value);
+  }
+}
+
+// V8 accounts the byte length of external array buffers itself, only the
+// unused capacity of the backing vector is invisible to it
+template <typename V>
+inline int64_t BufferSlack(const V &vec) {
+  return static_cast<int64_t>((vec.capacity() - vec.size()) *
+                              sizeof(typename V::value_type));
+}
+
+// scratch memory of a native call, released when the call returns. Short
+// allocations are served from a buffer on the stack, longer ones from
+// blocks reused by all calls of the thread, which is the thread of the env.
+class CallArena {
+ public:
+  CallArena();
+  ~CallArena();
+
+  CallArena(const CallArena &) = delete;
+  CallArena &operator=(const CallArena &) = delete;
+
+  // the arena of the innermost native call on this thread, if any
+  static CallArena *Current();
+
+  template <typename T>
+  T *Allocate(size_t count);
+
+  // decodes a string with `decode(buffer, size, &length)` in a single pass
+  // when it fits the free space, `slack` is the most units a truncated
+  // decode may leave unused and `max_length()` bounds the full length.
+  // Fails if `decode` does, i.e. the value is not a string.
+  template <typename Char, typename Decode, typename MaxLength>
+  std::optional<std::basic_string_view<Char>> DecodeString(
+      Decode decode, size_t slack, MaxLength max_length);
+
+ private:
+  static constexpr size_t kInlineSize = 256;
+  static constexpr size_t kBlockSize = 16 * 1024;
+  // blocks larger than this are freed when the outermost call returns
+  static constexpr size_t kMaxRetainedBlockSize = 1024 * 1024;
+
+  struct Block {
+    std::unique_ptr<char[]> data;
+    size_t size;
+  };
+
+  struct Blocks {
+    std::vector<Block> blocks;
+    size_t index = 0;
+    size_t offset = 0;
+  };
+
+  static Blocks &ThreadBlocks();
+  static inline thread_local CallArena *_current = nullptr;
+
+  static size_t AlignUp(size_t offset, size_t align) {
+    return (offset + align - 1) & ~(align - 1);
+  }
+
+  // the largest free space, either in the inline buffer or the current block
+  char *FreeSpace(size_t align, size_t *size);
+  // marks the free space returned by FreeSpace as used up to `end`
+  void Commit(char *end);
+  char *AllocateBytes(size_t size, size_t align);
+
+  CallArena *_previous;
+  size_t _mark_index;
+  size_t _mark_offset;
+  size_t _inline_used;
+  alignas(std::max_align_t) char _inline[kInlineSize];
+};
+
+inline CallArena::CallArena()
+    : _previous(_current),
+      _mark_index(ThreadBlocks().index),
+      _mark_offset(ThreadBlocks().offset),
+      _inline_used(0) {
+  _current = this;
+}
+
+inline CallArena::~CallArena() {
+  Blocks &blocks = ThreadBlocks();
+  blocks.index = _mark_index;
+  blocks.offset = _mark_offset;
+  _current = _previous;
+
+  if (_previous == nullptr) {
+    for (Block &block : blocks.blocks) {
+      if (block.size > kMaxRetainedBlockSize) {
+        block.data.reset();
+        block.size = 0;
+      }
+    }
+  }
+}
+
+inline CallArena *CallArena::Current() { return _current; }
+
+inline CallArena::Blocks &CallArena::ThreadBlocks() {
+  static thread_local Blocks blocks;
+  return blocks;
+}
+
+template <typename T>
+inline T *CallArena::Allocate(size_t count) {
+  return reinterpret_cast<T *>(AllocateBytes(count * sizeof(T), alignof(T)));
+}
+
+template <typename Char, typename Decode, typename MaxLength>
+inline std::optional<std::basic_string_view<Char>> CallArena::DecodeString(
+    Decode decode, size_t slack, MaxLength max_length) {
+  size_t free_size = 0;
+  Char *buffer = reinterpret_cast<Char *>(FreeSpace(alignof(Char), &free_size));
+  size_t capacity = free_size / sizeof(Char);
+  size_t length = 0;
+  if (capacity > slack + 1) {
+    if (!decode(buffer, capacity, &length)) {
+      return {};
+    }
+    if (length + slack + 1 < capacity) {
+      Commit(reinterpret_cast<char *>(buffer + length + 1));
+      return std::basic_string_view<Char>(buffer, length);
+    }
+  }
+
+  size_t size = max_length() + 1;
+  buffer = Allocate<Char>(size);
+  if (!decode(buffer, size, &length)) {
+    return {};
+  }
+  return std::basic_string_view<Char>(buffer, length);
+}
+
+inline char *CallArena::FreeSpace(size_t align, size_t *size) {
+  char *space = nullptr;
+  *size = 0;
+  size_t offset = AlignUp(_inline_used, align);
+  if (offset < kInlineSize) {
+    space = _inline + offset;
+    *size = kInlineSize - offset;
+  }
+  Blocks &blocks = ThreadBlocks();
+  if (blocks.index < blocks.blocks.size()) {
+    Block &block = blocks.blocks[blocks.index];
+    offset = AlignUp(blocks.offset, align);
+    if (offset < block.size && block.size - offset > *size) {
+      space = block.data.get() + offset;
+      *size = block.size - offset;
+    }
+  }
+  return space;
+}
+
+inline void CallArena::Commit(char *end) {
+  std::less<const char *> less;
+  if (!less(end, _inline) && !less(_inline + kInlineSize, end)) {
+    _inline_used = end - _inline;
+    return;
+  }
+  Blocks &blocks = ThreadBlocks();
+  blocks.offset = end - blocks.blocks[blocks.index].data.get();
+}
+
+inline char *CallArena::AllocateBytes(size_t size, size_t align) {
+  size_t offset = AlignUp(_inline_used, align);
+  if (offset + size <= kInlineSize) {
+    _inline_used = offset + size;
+    return _inline + offset;
+  }
+  // stop using the inline buffer, so FreeSpace looks at the blocks next
+  _inline_used = kInlineSize;
+
+  Blocks &blocks = ThreadBlocks();
+  if (blocks.index < blocks.blocks.size()) {
+    Block &block = blocks.blocks[blocks.index];
+    offset = AlignUp(blocks.offset, align);
+    if (offset + size <= block.size) {
+      blocks.offset = offset + size;
+      return block.data.get() + offset;
+    }
+    // an untouched block is replaced in place
+    if (blocks.offset != 0) {
+      ++blocks.index;
+    }
+  }
+
+  // blocks after the current one are unused and can be replaced
+  if (blocks.index == blocks.blocks.size()) {
+    blocks.blocks.push_back(Block{nullptr, 0});
+  }
+  Block &block = blocks.blocks[blocks.index];
+  if (block.size < size) {
+    block.size = std::max(size, kBlockSize);
+    block.data.reset(new char[block.size]);
+  }
+  blocks.offset = size;
+  return block.data.get();
+}
+
+template <>
+struct ContextOf<Napi::Env> {
+  using Storage = Napi::Env;
+  static Napi::Env Get(Napi::Env env) { return env; }
+};
+
+template <>
+struct ContextOf<CallArena> {
+  using Storage = CallArena *;
+  static CallArena *Get(Napi::Env) { return CallArena::Current(); }
+};
+
+template <>
+struct ContextOf<CallStats> {
+  using Storage = CallStats *;
+  static CallStats *Get(Napi::Env) { return CallStats::Current(); }
+};
+
+template <>
+struct ContextOf<StopToken> {
+  using Storage = StopToken;
+  static StopToken Get(Napi::Env env);
+};
+
+// the CallStats of a call, only measured for functions taking them
+template <bool kEnabled>
+struct CallStatsScope {
+  explicit CallStatsScope(size_t) {}
+  void Converted() {}
+};
+
+template <>
+struct CallStatsScope<true> {
+  CallStats stats;
+
+  explicit CallStatsScope(size_t argc) : stats(argc) {}
+  void Converted() {
+    stats._conversion = std::chrono::steady_clock::now() - stats._start;
+  }
+};
+
+template <typename Args>
+struct has_call_stats;
+
+template <typename... Args>
+struct has_call_stats<std::tuple<Args...>>
+    : std::disjunction<std::is_same<remove_cvref_t<Args>, CallStats>...> {};
+
+template <typename T>
+class ClassRegistration;
+
+// constructors of the classes a call returns, read once before the result
+// is converted rather than once per returned instance. Those not defined yet
+// (lazy classes) are left to the Registration.
+class ClassCache {
+ public:
+  ClassCache(Napi::Env env, ClassMetaInfo *const *meta_infos,
+             napi_value *values, size_t size)
+      : _env(env),
+        _meta_infos(meta_infos),
+        _values(values),
+        _size(size),
+        _previous(_current) {
+    Registration *reg = env.GetInstanceData<Registration>();
+    std::vector<Napi::FunctionReference> *classes =
+        reg != nullptr ? &reg->state_.classes : nullptr;
+    for (size_t i = 0; i < size; i++) {
+      size_t id = meta_infos[i]->id;
+      _values[i] = classes != nullptr && id < classes->size() &&
+                           !(*classes)[id].IsEmpty()
+                       ? static_cast<napi_value>((*classes)[id].Value())
+                       : nullptr;
+    }
+    _current = this;
+  }
+  ~ClassCache() { _current = _previous; }
+
+  ClassCache(const ClassCache &) = delete;
+  ClassCache &operator=(const ClassCache &) = delete;
+
+  // nullptr outside of a call returning classes
+  static ClassCache *Of(napi_env env) {
+    return _current != nullptr && _current->_env == env ? _current : nullptr;
+  }
+
+  // empty if the class wasn't defined when the call began
+  Napi::Function Get(const ClassMetaInfo *meta_info) const {
+    for (size_t i = 0; i < _size; i++) {
+      if (_meta_infos[i] == meta_info) {
+        return Napi::Function(_env, _values[i]);
+      }
+    }
+    return Napi::Function();
+  }
+
+ private:
+  napi_env _env;
+  ClassMetaInfo *const *_meta_infos;
+  napi_value *_values;
+  size_t _size;
+  ClassCache *_previous;
+
+  static inline thread_local ClassCache *_current = nullptr;
+};
+
+// the classes a value of T may hold, nested in containers, optionals and
+// variants
+template <typename T>
+struct returned_classes {
+  using type =
+      std::conditional_t<std::is_base_of_v<Class, T>, std::tuple<T>,
+                         std::tuple<>>;
+};
+
+template <template <typename...> class C, typename... Ts>
+struct returned_classes<C<Ts...>> {
+  using type = decltype(std::tuple_cat(
+      std::declval<typename returned_classes<std::conditional_t<
+          std::is_base_of_v<Class, C<Ts...>>, C<Ts...>, void>>::type>(),
+      std::declval<typename returned_classes<remove_cvref_t<Ts>>::type>()...));
+};
+
+// only set up for functions returning classes, an enclosing one is reused
+template <typename Classes>
+struct ClassCacheScope;
+
+template <>
+struct ClassCacheScope<std::tuple<>> {
+  explicit ClassCacheScope(Napi::Env) {}
+};
+
+template <typename... Ts>
+struct ClassCacheScope<std::tuple<Ts...>> {
+  ClassMetaInfo *meta_infos[sizeof...(Ts)] = {
+      &ClassRegistration<std::remove_cv_t<Ts>>::Instance()...};
+  napi_value values[sizeof...(Ts)];
+  std::optional<ClassCache> cache;
+
+  explicit ClassCacheScope(Napi::Env env) {
+    if (ClassCache::Of(env) == nullptr) {
+      cache.emplace(env, meta_infos, values, sizeof...(Ts));
+    }
+  }
+};
+
+// the CallArena of a call, only set up for functions taking views or the
+// arena itself
+template <bool kEnabled>
+struct CallArenaScope {
+  CallArenaScope() {}
+};
+
+template <>
+struct CallArenaScope<true> {
+  CallArena arena;
+};
+
+template <typename T>
+struct uses_call_arena : std::false_type {};
+
+template <>
+struct uses_call_arena<std::string_view> : std::true_type {};
+
+template <>
+struct uses_call_arena<std::u16string_view> : std::true_type {};
+
+template <>
+struct uses_call_arena<CallArena> : std::true_type {};
+
+// views nested in containers, optionals and variants
+template <template <typename...> class C, typename... Ts>
+struct uses_call_arena<C<Ts...>>
+    : std::disjunction<uses_call_arena<remove_cvref_t<Ts>>...> {};
+
+template <typename Args>
+struct has_call_arena;
+
+template <typename... Args>
+struct has_call_arena<std::tuple<Args...>>
+    : std::disjunction<uses_call_arena<remove_cvref_t<Args>>...> {};
+
+template <typename T, typename Enable = void>
+struct js_type_of {
+  static constexpr JSType value = JSType::kAny;
+};
+
+template <typename T>
+struct js_type_of<T, std::void_t<decltype(ValueTransformer<T>::kJSType)>> {
+  static constexpr JSType value = ValueTransformer<T>::kJSType;
+};
+
+template <typename T, typename Enable = void>
+struct has_typed_from_js : std::false_type {};
+
+template <typename T>
+struct has_typed_from_js<T, std::void_t<decltype(ValueTransformer<T>::FromJS(
+                                std::declval<Napi::Value>(), JSType::kAny))>>
+    : std::true_type {};
+
+// converts a value whose JSType was taken by TypeOf already, transformers
+// declaring FromJS(Napi::Value, JSType) use it instead of probing again
+template <typename T>
+inline std::optional<T> FromJS(Napi::Value value, JSType type) {
+  if constexpr (has_typed_from_js<T>::value) {
+    return ValueTransformer<T>::FromJS(value, type);
+  } else {
+    return ValueTransformer<T>::FromJS(value);
+  }
+}
+
+// the JSType of a value from a single napi_typeof. napi_object is reported
+// as JSType::kAnyObject unless object_kinds is set, then arrays, typed arrays
+// and other objects are told apart, which takes more calls.
+inline JSType TypeOf(Napi::Value value, bool object_kinds) {
+  napi_valuetype type = napi_undefined;
+  napi_typeof(value.Env(), value, &type);
+  switch (type) {
+    case napi_undefined:
+      return JSType::kUndefined;
+    case napi_null:
+      return JSType::kNull;
+    case napi_boolean:
+      return JSType::kBoolean;
+    case napi_number:
+      return JSType::kNumber;
+    case napi_string:
+      return JSType::kString;
+    case napi_symbol:
+      return JSType::kSymbol;
+    case napi_function:
+      return JSType::kFunction;
+    case napi_external:
+      return JSType::kExternal;
+    case napi_bigint:
+      return JSType::kBigInt;
+    case napi_object:
+      if (!object_kinds) {
+        return JSType::kAnyObject;
+      }
+      if (value.IsArray()) {
+        return JSType::kArray;
+      }
+      return value.IsTypedArray() ? JSType::kTypedArray : JSType::kObject;
+  }
+  return JSType::kAny;
+}
+
 }  // namespace details
 
 template <>
 struct ValueTransformer<Undefined> {
+  static constexpr JSType kJSType = JSType::kUndefined;
+
   static std::optional<Undefined> FromJS(Napi::Value v) {
     if (!v.IsUndefined()) {
       return {};
     }
     return Undefined{};
   }
+  static std::optional<Undefined> FromJS(Napi::Value, JSType type) {
+    if (type != JSType::kUndefined) {
+      return {};
+    }
+    return Undefined{};
+  }
   static Napi::Value ToJS(Napi::Env env, Undefined) { return env.Undefined(); }
 };
 
 template <>
 struct ValueTransformer<Null> {
+  static constexpr JSType kJSType = JSType::kNull;
+
   static std::optional<Null> FromJS(Napi::Value v) {
     if (!v.IsNull()) {
       return {};
     }
     return Null{};
   }
+  static std::optional<Null> FromJS(Napi::Value, JSType type) {
+    if (type != JSType::kNull) {
+      return {};
+    }
+    return Null{};
+  }
   static Napi::Value ToJS(Napi::Env env, Null) { return env.Null(); }
 };
 
 template <>
 struct ValueTransformer<Napi::Value> {
+  static constexpr JSType kJSType = JSType::kAny;
+
   static std::optional<Napi::Value> FromJS(Napi::Value v) { return v; }
   static Napi::Value ToJS(Napi::Env, Napi::Value val) { return val; }
 };
 
-template <typename T, bool (Napi::Value::*IsT)() const>
+// exact if every value of the JS types in kJSType is a T, e.g. not for Date
+template <typename T, bool (Napi::Value::*IsT)() const, JSType type,
+          bool exact = true>
 struct JSValueTransformer {
+  static constexpr JSType kJSType = type;
+
   static std::optional<T> FromJS(Napi::Value value) {
     if (!(value.*IsT)()) {
       return {};
@@ -179,83 +731,105 @@ struct JSValueTransformer {
     return value.As<T>();
   }
 
+  static std::optional<T> FromJS(Napi::Value value, JSType value_type) {
+    if (exact && (value_type & kJSType) == value_type) {
+      return value.As<T>();
+    }
+    return FromJS(value);
+  }
+
   static Napi::Value ToJS(Napi::Env, T val) { return val; }
 };
 
 template <>
 struct ValueTransformer<Napi::Boolean>
-    : public JSValueTransformer<Napi::Boolean, &Napi::Value::IsBoolean> {};
+    : public JSValueTransformer<Napi::Boolean, &Napi::Value::IsBoolean,
+                                JSType::kBoolean> {};
 
 template <>
 struct ValueTransformer<Napi::Number>
-    : public JSValueTransformer<Napi::Number, &Napi::Value::IsNumber> {};
+    : public JSValueTransformer<Napi::Number, &Napi::Value::IsNumber,
+                                JSType::kNumber> {};
 
 #if NAPI_VERSION > 5
 template <>
 struct ValueTransformer<Napi::BigInt>
-    : public JSValueTransformer<Napi::BigInt, &Napi::Value::IsBigInt> {};
+    : public JSValueTransformer<Napi::BigInt, &Napi::Value::IsBigInt,
+                                JSType::kBigInt> {};
 #endif
 
 #if (NAPI_VERSION > 4)
 template <>
 struct ValueTransformer<Napi::Date>
-    : public JSValueTransformer<Napi::Date, &Napi::Value::IsDate> {};
+    : public JSValueTransformer<Napi::Date, &Napi::Value::IsDate,
+                                JSType::kObject, false> {};
 #endif
 
 template <>
 struct ValueTransformer<Napi::String>
-    : public JSValueTransformer<Napi::String, &Napi::Value::IsString> {};
+    : public JSValueTransformer<Napi::String, &Napi::Value::IsString,
+                                JSType::kString> {};
 
 template <>
 struct ValueTransformer<Napi::Symbol>
-    : public JSValueTransformer<Napi::Symbol, &Napi::Value::IsSymbol> {};
+    : public JSValueTransformer<Napi::Symbol, &Napi::Value::IsSymbol,
+                                JSType::kSymbol> {};
 
 template <>
 struct ValueTransformer<Napi::Array>
-    : public JSValueTransformer<Napi::Array, &Napi::Value::IsArray> {};
+    : public JSValueTransformer<Napi::Array, &Napi::Value::IsArray,
+                                JSType::kArray> {};
 
 template <>
 struct ValueTransformer<Napi::ArrayBuffer>
-    : public JSValueTransformer<Napi::ArrayBuffer,
-                                &Napi::Value::IsArrayBuffer> {};
+    : public JSValueTransformer<Napi::ArrayBuffer, &Napi::Value::IsArrayBuffer,
+                                JSType::kObject, false> {};
 
 template <>
 struct ValueTransformer<Napi::TypedArray>
-    : public JSValueTransformer<Napi::TypedArray, &Napi::Value::IsTypedArray> {
-};
+    : public JSValueTransformer<Napi::TypedArray, &Napi::Value::IsTypedArray,
+                                JSType::kTypedArray> {};
 
 template <>
 struct ValueTransformer<Napi::Object>
-    : public JSValueTransformer<Napi::Object, &Napi::Value::IsObject> {};
+    : public JSValueTransformer<Napi::Object, &Napi::Value::IsObject,
+                                JSType::kAnyObject | JSType::kFunction> {};
 
 template <>
 struct ValueTransformer<Napi::Function>
-    : public JSValueTransformer<Napi::Function, &Napi::Value::IsFunction> {};
+    : public JSValueTransformer<Napi::Function, &Napi::Value::IsFunction,
+                                JSType::kFunction> {};
 
 template <>
 struct ValueTransformer<Napi::Promise>
-    : public JSValueTransformer<Napi::Promise, &Napi::Value::IsPromise> {};
+    : public JSValueTransformer<Napi::Promise, &Napi::Value::IsPromise,
+                                JSType::kObject, false> {};
 
 template <>
 struct ValueTransformer<Napi::DataView>
-    : public JSValueTransformer<Napi::DataView, &Napi::Value::IsDataView> {};
+    : public JSValueTransformer<Napi::DataView, &Napi::Value::IsDataView,
+                                JSType::kObject, false> {};
 
 template <typename T>
 struct ValueTransformer<Napi::Buffer<T>>
-    : public JSValueTransformer<Napi::Buffer<T>, &Napi::Value::IsBuffer> {};
+    : public JSValueTransformer<Napi::Buffer<T>, &Napi::Value::IsBuffer,
+                                JSType::kTypedArray, false> {};
 
 template <typename T>
 struct ValueTransformer<Napi::External<T>>
-    : public JSValueTransformer<Napi::External<T>, &Napi::Value::IsExternal> {};
+    : public JSValueTransformer<Napi::External<T>, &Napi::Value::IsExternal,
+                                JSType::kExternal> {};
 
 template <typename T, napi_typedarray_type type>
 struct TypedArrayTransformer {
+  static constexpr JSType kJSType = JSType::kTypedArray;
+
   static std::optional<T> FromJS(Napi::Value value) {
-    if (!value.IsTypedArray()) {
-      return {};
-    }
-    Napi::TypedArray arr = value.As<Napi::TypedArray>();
-    if (arr.TypedArrayType() != type) {
+    // fails for values other than typed arrays
+    napi_typedarray_type actual;
+    if (napi_get_typedarray_info(value.Env(), value, &actual, nullptr, nullptr,
+                                 nullptr, nullptr) != napi_ok ||
+        actual != type) {
       return {};
     }
     return value.As<T>();
@@ -270,13 +844,13 @@ struct ValueTransformer<Napi::Int8Array>
 
 template <>
 struct ValueTransformer<Napi::Uint8Array> {
+  static constexpr JSType kJSType = JSType::kTypedArray;
+
   static std::optional<Napi::Uint8Array> FromJS(Napi::Value value) {
-    if (!value.IsTypedArray()) {
-      return {};
-    }
-    Napi::TypedArray arr = value.As<Napi::TypedArray>();
-    if (arr.TypedArrayType() != napi_uint8_array &&
-        arr.TypedArrayType() != napi_uint8_clamped_array) {
+    napi_typedarray_type type;
+    if (napi_get_typedarray_info(value.Env(), value, &type, nullptr, nullptr,
+                                 nullptr, nullptr) != napi_ok ||
+        (type != napi_uint8_array && type != napi_uint8_clamped_array)) {
       return {};
     }
     return value.As<Napi::Uint8Array>();
@@ -322,11 +896,14 @@ struct ValueTransformer<Napi::BigUint64Array>
 
 template <>
 struct ValueTransformer<bool> {
+  static constexpr JSType kJSType = JSType::kBoolean;
+
   static std::optional<bool> FromJS(Napi::Value value) {
-    if (!value.IsBoolean()) {
+    bool result = false;
+    if (napi_get_value_bool(value.Env(), value, &result) != napi_ok) {
       return {};
     }
-    return value.As<Napi::Boolean>().Value();
+    return result;
   }
 
   static Napi::Value ToJS(Napi::Env env, bool num) {
@@ -336,11 +913,14 @@ struct ValueTransformer<bool> {
 
 template <>
 struct ValueTransformer<double> {
+  static constexpr JSType kJSType = JSType::kNumber;
+
   static std::optional<double> FromJS(Napi::Value value) {
-    if (!value.IsNumber()) {
+    double result = 0;
+    if (napi_get_value_double(value.Env(), value, &result) != napi_ok) {
       return {};
     }
-    return value.As<Napi::Number>().DoubleValue();
+    return result;
   }
 
   static Napi::Value ToJS(Napi::Env env, double num) {
@@ -350,11 +930,14 @@ struct ValueTransformer<double> {
 
 template <>
 struct ValueTransformer<float> {
+  static constexpr JSType kJSType = JSType::kNumber;
+
   static std::optional<float> FromJS(Napi::Value value) {
-    if (!value.IsNumber()) {
+    double result = 0;
+    if (napi_get_value_double(value.Env(), value, &result) != napi_ok) {
       return {};
     }
-    return value.As<Napi::Number>().FloatValue();
+    return static_cast<float>(result);
   }
 
   static Napi::Value ToJS(Napi::Env env, float num) {
@@ -367,11 +950,14 @@ struct ValueTransformer<Uint,
                         std::enable_if_t<std::is_same_v<Uint, uint8_t> ||
                                          std::is_same_v<Uint, uint16_t> ||
                                          std::is_same_v<Uint, uint32_t>>> {
+  static constexpr JSType kJSType = JSType::kNumber;
+
   static std::optional<Uint> FromJS(Napi::Value value) {
-    if (!value.IsNumber()) {
+    uint32_t result = 0;
+    if (napi_get_value_uint32(value.Env(), value, &result) != napi_ok) {
       return {};
     }
-    return value.As<Napi::Number>().Uint32Value();
+    return static_cast<Uint>(result);
   }
 
   static Napi::Value ToJS(Napi::Env env, Uint num) {
@@ -383,11 +969,14 @@ template <typename Int>
 struct ValueTransformer<Int, std::enable_if_t<std::is_same_v<Int, int8_t> ||
                                               std::is_same_v<Int, int16_t> ||
                                               std::is_same_v<Int, int32_t>>> {
+  static constexpr JSType kJSType = JSType::kNumber;
+
   static std::optional<Int> FromJS(Napi::Value value) {
-    if (!value.IsNumber()) {
+    int32_t result = 0;
+    if (napi_get_value_int32(value.Env(), value, &result) != napi_ok) {
       return {};
     }
-    return value.As<Napi::Number>().Int32Value();
+    return static_cast<Int>(result);
   }
 
   static Napi::Value ToJS(Napi::Env env, Int num) {
@@ -398,12 +987,16 @@ struct ValueTransformer<Int, std::enable_if_t<std::is_same_v<Int, int8_t> ||
 #if NAPI_VERSION > 5
 template <>
 struct ValueTransformer<int64_t> {
+  static constexpr JSType kJSType = JSType::kBigInt;
+
   static std::optional<int64_t> FromJS(Napi::Value value) {
-    if (!value.IsBigInt()) {
+    int64_t result = 0;
+    bool lossless = true;
+    if (napi_get_value_bigint_int64(value.Env(), value, &result, &lossless) !=
+        napi_ok) {
       return {};
     }
-    bool lossless = true;
-    return value.As<Napi::BigInt>().Int64Value(&lossless);
+    return result;
   }
 
   static Napi::Value ToJS(Napi::Env env, int64_t num) {
@@ -413,18 +1006,63 @@ struct ValueTransformer<int64_t> {
 
 template <>
 struct ValueTransformer<uint64_t> {
+  static constexpr JSType kJSType = JSType::kBigInt;
+
   static std::optional<uint64_t> FromJS(Napi::Value value) {
-    if (!value.IsBigInt()) {
+    uint64_t result = 0;
+    bool lossless = true;
+    if (napi_get_value_bigint_uint64(value.Env(), value, &result,
+                                     &lossless) != napi_ok) {
       return {};
     }
-    bool lossless = true;
-    return value.As<Napi::BigInt>().Uint64Value(&lossless);
+    return result;
   }
 
   static Napi::Value ToJS(Napi::Env env, uint64_t num) {
     return Napi::BigInt::New(env, num);
   }
 };
+
+template <typename T>
+inline SafeInteger<T>::SafeInteger(T value) NAPI_NOEXCEPT : _value(value) {}
+
+template <typename T>
+inline SafeInteger<T>::operator T() const NAPI_NOEXCEPT {
+  return _value;
+}
+
+template <typename T>
+struct ValueTransformer<SafeInteger<T>> {
+  // Number.MAX_SAFE_INTEGER
+  static constexpr T kMaxSafe = (T(1) << 53) - 1;
+
+  static constexpr JSType kJSType = JSType::kNumber | JSType::kBigInt;
+
+  static std::optional<SafeInteger<T>> FromJS(Napi::Value value) {
+    double num = 0;
+    if (napi_get_value_double(value.Env(), value, &num) == napi_ok) {
+      // rejects fractions, NaN and numbers which may have been rounded
+      if (num != std::trunc(num) || num > kMaxSafe ||
+          num < (std::is_signed_v<T> ? -static_cast<double>(kMaxSafe) : 0)) {
+        return {};
+      }
+      return static_cast<T>(num);
+    }
+    return ValueTransformer<T>::FromJS(value);
+  }
+
+  static Napi::Value ToJS(Napi::Env env, SafeInteger<T> num) {
+    T value = num;
+    bool safe = value <= kMaxSafe;
+    if constexpr (std::is_signed_v<T>) {
+      safe = safe && value >= -kMaxSafe;
+    }
+    if (safe) {
+      return Napi::Number::New(env, static_cast<double>(value));
+    }
+    return ValueTransformer<T>::ToJS(env, value);
+  }
+};
 #endif
 
 template <typename T>
@@ -436,8 +1074,36 @@ struct ValueTransformer<
   }
 };
 
+// views borrow the scratch arena of the native call, they are only valid
+// until the call returns and can't be converted outside of one
 template <>
 struct ValueTransformer<std::string_view> {
+  static constexpr JSType kJSType = JSType::kString;
+
+  static std::optional<std::string_view> FromJS(Napi::Value value) {
+    details::CallArena *arena = details::CallArena::Current();
+    if (arena == nullptr) {
+      NAPI_THROW(Napi::Error::New(value.Env(),
+                                  "string views can only be converted for "
+                                  "arguments of a native call"),
+                 std::nullopt);
+    }
+    napi_env env = value.Env();
+    // V8 never splits a UTF-8 sequence, up to 3 bytes may be left unused,
+    // and a UTF-16 unit takes at most 3 bytes. The UTF-16 length is O(1).
+    return arena->DecodeString<char>(
+        [&](char *buf, size_t size, size_t *length) {
+          return napi_get_value_string_utf8(env, value, buf, size, length) ==
+                 napi_ok;
+        },
+        3,
+        [&]() {
+          size_t length = 0;
+          napi_get_value_string_utf16(env, value, nullptr, 0, &length);
+          return length * 3;
+        });
+  }
+
   static Napi::Value ToJS(Napi::Env env, std::string_view str) {
     return Napi::String::New(env, str.data(), str.size());
   }
@@ -445,6 +1111,28 @@ struct ValueTransformer<std::string_view> {
 
 template <>
 struct ValueTransformer<std::u16string_view> {
+  static constexpr JSType kJSType = JSType::kString;
+
+  static std::optional<std::u16string_view> FromJS(Napi::Value value) {
+    details::CallArena *arena = details::CallArena::Current();
+    if (arena == nullptr) {
+      NAPI_THROW(Napi::Error::New(value.Env(),
+                                  "string views can only be converted for "
+                                  "arguments of a native call"),
+                 std::nullopt);
+    }
+    napi_env env = value.Env();
+    auto decode = [&](char16_t *buf, size_t size, size_t *length) {
+      return napi_get_value_string_utf16(env, value, buf, size, length) ==
+             napi_ok;
+    };
+    return arena->DecodeString<char16_t>(decode, 0, [&]() {
+      size_t length = 0;
+      decode(nullptr, 0, &length);
+      return length;
+    });
+  }
+
   static Napi::Value ToJS(Napi::Env env, std::u16string_view str) {
     return Napi::String::New(env, str.data(), str.size());
   }
@@ -452,35 +1140,346 @@ struct ValueTransformer<std::u16string_view> {
 
 template <>
 struct ValueTransformer<std::string> {
+  static constexpr JSType kJSType = JSType::kString;
+
   static std::optional<std::string> FromJS(Napi::Value value) {
-    if (!value.IsString()) {
+    napi_env env = value.Env();
+    size_t length = 0;
+    if (napi_get_value_string_utf8(env, value, nullptr, 0, &length) !=
+        napi_ok) {
       return {};
     }
-    return value.As<Napi::String>().Utf8Value();
+    std::string result(length, '\0');
+    napi_get_value_string_utf8(env, value, result.data(), length + 1, nullptr);
+    return result;
   }
 
-  static Napi::Value ToJS(Napi::Env env, std::string str) {
+  static Napi::Value ToJS(Napi::Env env, const std::string &str) {
     return Napi::String::New(env, str);
   }
 };
 
 template <>
 struct ValueTransformer<std::u16string> {
+  static constexpr JSType kJSType = JSType::kString;
+
   static std::optional<std::u16string> FromJS(Napi::Value value) {
-    if (!value.IsString()) {
+    napi_env env = value.Env();
+    size_t length = 0;
+    if (napi_get_value_string_utf16(env, value, nullptr, 0, &length) !=
+        napi_ok) {
       return {};
     }
-    return value.As<Napi::String>().Utf16Value();
+    std::u16string result(length, u'\0');
+    napi_get_value_string_utf16(env, value, result.data(), length + 1,
+                                nullptr);
+    return result;
   }
 
-  static Napi::Value ToJS(Napi::Env env, std::u16string str) {
+  static Napi::Value ToJS(Napi::Env env, const std::u16string &str) {
     return Napi::String::New(env, str);
   }
 };
 
-template <typename T>
-struct ValueTransformer<std::optional<T>> {
-  static Napi::Value ToJS(Napi::Env env, std::optional<T> val) {
+namespace details {
+// whether str is ASCII, which is Latin-1 as well
+inline bool IsAscii(const char *str, size_t length) {
+  size_t i = 0;
+  for (; i + sizeof(uint64_t) <= length; i += sizeof(uint64_t)) {
+    uint64_t word;
+    std::memcpy(&word, str + i, sizeof(word));
+    if ((word & 0x8080808080808080ull) != 0) {
+      return false;
+    }
+  }
+  for (; i < length; ++i) {
+    if ((static_cast<unsigned char>(str[i]) & 0x80) != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+}  // namespace details
+
+template <typename S>
+struct ValueTransformer<ExternalString<S>> {
+  static_assert(std::is_same_v<S, std::string> ||
+                    std::is_same_v<S, std::u16string>,
+                "ExternalString holds a std::string or a std::u16string");
+
+  static constexpr JSType kJSType = JSType::kString;
+
+  static std::optional<ExternalString<S>> FromJS(Napi::Value value) {
+    std::optional<S> str = ValueTransformer<S>::FromJS(value);
+    if (!str.has_value()) {
+      return {};
+    }
+    return ExternalString<S>(std::move(*str));
+  }
+
+  static Napi::Value ToJS(Napi::Env env, ExternalString<S> str) {
+    napi_value result;
+    napi_status status;
+    if constexpr (std::is_same_v<S, std::string>) {
+      if (!details::IsAscii(str.data(), str.size())) {
+        return ValueTransformer<S>::ToJS(env, str);
+      }
+#ifdef NAAH_EXTERNAL_STRINGS
+      S *holder = new S(std::move(str));
+      // the finalizer runs at once if the runtime copies the string
+      status = node_api_create_external_string_latin1(
+          env, holder->data(), holder->size(), Finalize, holder, &result,
+          nullptr);
+#else
+      status = napi_create_string_latin1(env, str.data(), str.size(), &result);
+#endif
+    } else {
+#ifdef NAAH_EXTERNAL_STRINGS
+      S *holder = new S(std::move(str));
+      status = node_api_create_external_string_utf16(
+          env, holder->data(), holder->size(), Finalize, holder, &result,
+          nullptr);
+#else
+      status = napi_create_string_utf16(env, str.data(), str.size(), &result);
+#endif
+    }
+    NAPI_THROW_IF_FAILED(env, status, Napi::Value());
+    return Napi::Value(env, result);
+  }
+
+#ifdef NAAH_EXTERNAL_STRINGS
+ private:
+  // the type of env differs between Node-API versions
+  template <typename Env>
+  static void Finalize(Env, void *, void *hint) {
+    delete static_cast<S *>(hint);
+  }
+#endif
+};
+
+namespace details {
+
+constexpr uint32_t HashString(std::string_view str, uint32_t seed) {
+  uint32_t hash = 2166136261u ^ seed;  // FNV-1a
+  for (char c : str) {
+    hash ^= static_cast<uint8_t>(c);
+    hash *= 16777619u;
+  }
+  return hash ^ (hash >> 15);
+}
+
+struct PerfectHash {
+  uint32_t seed;
+  size_t bits;
+
+  constexpr size_t Slot(std::string_view str) const {
+    return HashString(str, seed) & ((size_t{1} << bits) - 1);
+  }
+};
+
+template <typename E, typename Enable = void>
+struct has_enum_values : std::false_type {};
+
+template <typename E>
+struct has_enum_values<E, std::void_t<decltype(Enum<E>::values)>>
+    : std::true_type {};
+
+template <typename E>
+constexpr size_t kEnumSize = std::extent_v<decltype(Enum<E>::values)>;
+
+template <typename E>
+constexpr bool EnumHashCollides(PerfectHash hash) {
+  std::array<size_t, kEnumSize<E>> slots{};
+  for (size_t i = 0; i < kEnumSize<E>; ++i) {
+    slots[i] = hash.Slot(Enum<E>::values[i].name);
+    for (size_t j = 0; j < i; ++j) {
+      if (slots[i] == slots[j]) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+// grows the table until some seed maps every name to a slot of its own,
+// gives up (bits == 0) if the names aren't unique
+template <typename E>
+constexpr PerfectHash SearchEnumHash() {
+  size_t bits = 1;
+  while ((size_t{1} << bits) < kEnumSize<E> * 2) {
+    ++bits;
+  }
+  for (; bits <= 16; ++bits) {
+    for (uint32_t seed = 0; seed < 64; ++seed) {
+      if (!EnumHashCollides<E>({seed, bits})) {
+        return {seed, bits};
+      }
+    }
+  }
+  return {0, 0};
+}
+
+template <typename E>
+class EnumTable {
+ public:
+  static constexpr size_t kSize = kEnumSize<E>;
+  static constexpr PerfectHash kHash = SearchEnumHash<E>();
+  static_assert(kHash.bits != 0, "names of naah::Enum must be unique");
+
+  static constexpr size_t kMaxLength = [] {
+    size_t length = 0;
+    for (const EnumValue<E> &v : Enum<E>::values) {
+      length = std::max(length, v.name.size());
+    }
+    return length;
+  }();
+
+  // index + 1 of the name hashed to each slot, 0 for empty slots
+  static constexpr auto kSlots = [] {
+    std::array<uint16_t, size_t{1} << kHash.bits> slots{};
+    for (size_t i = 0; i < kSize; ++i) {
+      slots[kHash.Slot(Enum<E>::values[i].name)] = static_cast<uint16_t>(i + 1);
+    }
+    return slots;
+  }();
+
+  static_assert(std::is_enum_v<E>, "naah::Enum is specialized for enums");
+  using Underlying = std::underlying_type_t<E>;
+  using Offset = std::make_unsigned_t<Underlying>;
+
+  static constexpr Underlying kMinValue = [] {
+    Underlying min = static_cast<Underlying>(Enum<E>::values[0].value);
+    for (const EnumValue<E> &v : Enum<E>::values) {
+      min = std::min(min, static_cast<Underlying>(v.value));
+    }
+    return min;
+  }();
+
+  // values below the smallest one wrap around past kMaxOffset
+  static constexpr Offset OffsetOf(E value) {
+    return static_cast<Offset>(static_cast<Offset>(value) -
+                               static_cast<Offset>(kMinValue));
+  }
+
+  static constexpr Offset kMaxOffset = [] {
+    Offset max = 0;
+    for (const EnumValue<E> &v : Enum<E>::values) {
+      max = std::max(max, OffsetOf(v.value));
+    }
+    return max;
+  }();
+
+  // values close enough are indexed by their offset, others are binary
+  // searched
+  static constexpr bool kDense = kMaxOffset < 256;
+
+  // index + 1 of the first name of the value at each offset, 0 for gaps
+  static constexpr auto kIndices = [] {
+    std::array<uint16_t, kDense ? size_t{kMaxOffset} + 1 : 0> indices{};
+    for (size_t i = 0; i < kSize && kDense; ++i) {
+      uint16_t &index = indices[OffsetOf(Enum<E>::values[i].value)];
+      if (index == 0) {
+        index = static_cast<uint16_t>(i + 1);
+      }
+    }
+    return indices;
+  }();
+
+  // indices of the names ordered by their offsets, first names first
+  static constexpr auto kSorted = [] {
+    std::array<uint16_t, kSize> sorted{};
+    for (size_t i = 0; i < kSize; ++i) {
+      size_t j = i;
+      for (; j > 0 && OffsetOf(Enum<E>::values[sorted[j - 1]].value) >
+                          OffsetOf(Enum<E>::values[i].value);
+           --j) {
+        sorted[j] = sorted[j - 1];
+      }
+      sorted[j] = static_cast<uint16_t>(i);
+    }
+    return sorted;
+  }();
+
+  // the index of the first name of value, kSize if it has none
+  static size_t IndexOf(E value) {
+    Offset offset = OffsetOf(value);
+    if constexpr (kDense) {
+      return offset <= kMaxOffset && kIndices[offset] != 0
+                 ? kIndices[offset] - 1
+                 : kSize;
+    } else {
+      const uint16_t *it = std::lower_bound(
+          kSorted.begin(), kSorted.end(), offset, [](uint16_t i, Offset o) {
+            return OffsetOf(Enum<E>::values[i].value) < o;
+          });
+      return it != kSorted.end() && OffsetOf(Enum<E>::values[*it].value) ==
+                                         offset
+                 ? *it
+                 : kSize;
+    }
+  }
+
+  // the first interned string slot of the names
+  static size_t Base() {
+    static const size_t base = EnvState::ReserveStrings(kSize);
+    return base;
+  }
+
+  static const EnumValue<E> *Find(std::string_view name) {
+    uint16_t index = kSlots[kHash.Slot(name)];
+    if (index == 0 || Enum<E>::values[index - 1].name != name) {
+      return nullptr;
+    }
+    return &Enum<E>::values[index - 1];
+  }
+};
+
+}  // namespace details
+
+template <typename E>
+struct ValueTransformer<E,
+                        std::enable_if_t<details::has_enum_values<E>::value>> {
+  using Table = details::EnumTable<E>;
+
+  static constexpr JSType kJSType = JSType::kString;
+
+  static std::optional<E> FromJS(Napi::Value value) {
+    napi_env env = value.Env();
+    // a UTF-8 sequence is never split, names longer than kMaxLength won't
+    // fit in the slack
+    char buf[Table::kMaxLength + 5];
+    size_t length = 0;
+    if (napi_get_value_string_utf8(env, value, buf, sizeof(buf), &length) !=
+        napi_ok) {
+      return {};
+    }
+    const EnumValue<E> *found = Table::Find(std::string_view(buf, length));
+    if (found == nullptr) {
+      return {};
+    }
+    return found->value;
+  }
+
+  static Napi::Value ToJS(Napi::Env env, E value) {
+    size_t i = Table::IndexOf(value);
+    if (i == Table::kSize) {
+      return env.Undefined();
+    }
+    return details::EnvState::String(env, Table::Base() + i,
+                                     Enum<E>::values[i].name);
+  }
+};
+
+template <>
+struct ValueTransformer<InternedString> {
+  static Napi::Value ToJS(Napi::Env env, const InternedString &str) {
+    return details::EnvState::String(env, str.slot(), str.str());
+  }
+};
+
+template <typename T>
+struct ValueTransformer<std::optional<T>> {
+  static Napi::Value ToJS(Napi::Env env, std::optional<T> val) {
     if (val.has_value()) {
       return ValueTransformer<T>::ToJS(env, std::move(*val));
     }
@@ -493,23 +1492,46 @@ struct ValueTransformer<std::variant<Args...>> {
  private:
   using Variants = std::variant<Args...>;
 
+  // arrays and typed arrays are told apart from other objects only if some
+  // alternative accepts some of them but not all
+  static constexpr bool kObjectKinds =
+      (... || ((details::js_type_of<Args>::value & JSType::kAnyObject) !=
+                   JSType::kNone &&
+               (details::js_type_of<Args>::value & JSType::kAnyObject) !=
+                   JSType::kAnyObject));
+
+  // alternatives are tried in order, skipping those which don't accept the
+  // JS type of the value
   template <size_t I>
-  static std::optional<Variants> FromJS([[maybe_unused]] Napi::Value value) {
+  static std::optional<Variants> FromJSAt([[maybe_unused]] Napi::Value value,
+                                          [[maybe_unused]] JSType type) {
     if constexpr (I < sizeof...(Args)) {
       using TypeI = std::variant_alternative_t<I, Variants>;
-      std::optional<TypeI> result = ValueTransformer<TypeI>::FromJS(value);
-      if (result.has_value()) {
-        return std::move(*result);
+      if ((details::js_type_of<TypeI>::value & type) != JSType::kNone) {
+        std::optional<TypeI> result = details::FromJS<TypeI>(value, type);
+        if (result.has_value()) {
+          return std::move(*result);
+        }
       }
-      return FromJS<I + 1>(value);
+      return FromJSAt<I + 1>(value, type);
     } else {
       return {};
     }
   }
 
  public:
+  static constexpr JSType kJSType =
+      (JSType::kNone | ... | details::js_type_of<Args>::value);
+
   static std::optional<Variants> FromJS(Napi::Value value) {
-    return FromJS<0>(value);
+    return FromJSAt<0>(value, details::TypeOf(value, kObjectKinds));
+  }
+
+  static std::optional<Variants> FromJS(Napi::Value value, JSType type) {
+    if (kObjectKinds && type == JSType::kAnyObject) {
+      type = details::TypeOf(value, true);
+    }
+    return FromJSAt<0>(value, type);
   }
 
   static Napi::Value ToJS(Napi::Env env, Variants v) {
@@ -522,128 +1544,1022 @@ struct ValueTransformer<std::variant<Args...>> {
   }
 };
 
-template <typename... Args>
-struct ValueTransformer<std::tuple<Args...>> {
- private:
-  using Tuple = std::tuple<Args...>;
+template <typename... Args>
+struct ValueTransformer<std::tuple<Args...>> {
+ private:
+  using Tuple = std::tuple<Args...>;
+
+  template <size_t... Is>
+  static std::vector<napi_value> ToVectorImpl([[maybe_unused]] Napi::Env env,
+                                              [[maybe_unused]] Tuple t,
+                                              std::index_sequence<Is...>) {
+    std::vector<napi_value> result(std::tuple_size_v<Tuple>);
+    ((result[Is] = ValueTransformer<std::tuple_element_t<Is, Tuple>>::ToJS(
+          env, std::move(std::get<Is>(t)))),
+     ...);
+    return result;
+  }
+
+  template <size_t... Is>
+  static Tuple FromStorage(
+      [[maybe_unused]] details::ArgsStorage<Args...> &items,
+      std::index_sequence<Is...>) {
+    return Tuple(items.template Get<Is>()...);
+  }
+
+ public:
+  static constexpr JSType kJSType = JSType::kArray;
+
+  static std::vector<napi_value> ToVector(Napi::Env env, Tuple t) {
+    return ToVectorImpl(env, std::move(t), std::index_sequence_for<Args...>{});
+  }
+
+  static std::optional<Tuple> FromJS(Napi::Value value) {
+    if (!value.IsArray()) {
+      return {};
+    }
+    bool ok = true;
+    details::ArgsStorage<Args...> items =
+        details::ArgsStorage<Args...>::Convert(value.As<Napi::Array>(), 0, ok);
+    if (!ok) {
+      return {};
+    }
+    return FromStorage(items, std::index_sequence_for<Args...>{});
+  }
+
+  static Napi::Value ToJS(Napi::Env env, Tuple t) {
+    return std::apply(
+        [&](auto &&...elements) -> Napi::Array {
+          constexpr size_t size = sizeof...(elements);
+
+          Napi::Array result = Napi::Array::New(env, size);
+
+          std::vector<napi_value> vec = ToVector(env, std::move(t));
+          for (uint32_t i = 0; i < vec.size(); i++) {
+            result.Set(i, Napi::Value(env, vec[i]));
+          }
+
+          return result;
+        },
+        t);
+  }
+};
+
+namespace details {
+
+constexpr size_t kChunkSize = 128;
+
+// whether a converted T keeps JS handles, which must outlive the scope they
+// were created in. Objects know it once their members are registered.
+template <typename T, typename Enable = void>
+struct holds_handles {
+  static bool Get() { return std::is_base_of_v<Napi::Value, T>; }
+};
+
+template <typename T>
+struct holds_handles<Lazy<T>> {
+  static bool Get() { return true; }
+};
+
+template <typename T>
+struct holds_handles<Out<T>> {
+  static bool Get() { return true; }
+};
+
+template <typename T>
+struct holds_handles<std::optional<T>> : holds_handles<T> {};
+
+template <typename T, typename A>
+struct holds_handles<std::vector<T, A>> : holds_handles<T> {};
+
+template <typename... Ts>
+struct holds_handles<std::variant<Ts...>> {
+  static bool Get() { return (holds_handles<Ts>::Get() || ...); }
+};
+
+template <typename... Ts>
+struct holds_handles<std::tuple<Ts...>> {
+  static bool Get() { return (holds_handles<Ts>::Get() || ...); }
+};
+
+// Converts the elements of a container in handle scopes of kChunkSize
+// elements, so the handles stay bounded instead of piling up in the scope of
+// the call until it returns. Values which outlive an element are created
+// before the first Next(). Disabled for elements holding handles.
+class ChunkScope {
+ public:
+  explicit ChunkScope(napi_env env, bool enabled = true)
+      : _env(env), _enabled(enabled) {}
+  ChunkScope(const ChunkScope &) = delete;
+  ChunkScope &operator=(const ChunkScope &) = delete;
+  ~ChunkScope() { Close(); }
+
+  // before each element
+  void Next() {
+    if (_enabled && _count++ % kChunkSize == 0) {
+      Close();
+      napi_open_handle_scope(_env, &_scope);
+    }
+  }
+
+ private:
+  void Close() {
+    if (_scope != nullptr) {
+      napi_close_handle_scope(_env, _scope);
+      _scope = nullptr;
+    }
+  }
+
+  napi_env _env;
+  bool _enabled;
+  napi_handle_scope _scope = nullptr;
+  size_t _count = 0;
+};
+
+}  // namespace details
+
+template <typename T>
+struct ValueTransformer<std::vector<T>> {
+  static constexpr JSType kJSType = JSType::kArray;
+
+  static std::optional<std::vector<T>> FromJS(Napi::Value value) {
+    // fails for values other than arrays
+    uint32_t len = 0;
+    if (napi_get_array_length(value.Env(), value, &len) != napi_ok) {
+      return {};
+    }
+    Napi::Array arr = value.As<Napi::Array>();
+    std::vector<T> result;
+    result.reserve(len);
+    details::ChunkScope scope(value.Env(), !details::holds_handles<T>::Get());
+    for (uint32_t i = 0; i < len; i++) {
+      scope.Next();
+      std::optional<T> item = ValueTransformer<T>::FromJS(arr.Get(i));
+      if (!item.has_value()) {
+        return {};
+      }
+      result.push_back(std::move(*item));
+    }
+    return result;
+  }
+
+  static Napi::Value ToJS(Napi::Env env, std::vector<T> arr) {
+    Napi::Array result = Napi::Array::New(env, arr.size());
+    details::ChunkScope scope(env);
+    for (uint32_t i = 0; i < arr.size(); i++) {
+      scope.Next();
+      result.Set(i, ValueTransformer<T>::ToJS(env, std::move(arr[i])));
+    }
+    return result;
+  }
+};
+
+namespace details {
+
+enum CollectionKind : uint32_t { kMapCollection, kSetCollection, kObjectCollection };
+
+template <typename C, typename Enable = void>
+struct has_reserve : std::false_type {};
+
+template <typename C>
+struct has_reserve<C, std::void_t<decltype(std::declval<C &>().reserve(0))>>
+    : std::true_type {};
+
+template <typename C>
+inline void ReserveFor(C &c, size_t count) {
+  if constexpr (has_reserve<C>::value) {
+    c.reserve(count);
+  }
+}
+
+// Collections are built and read through Node-API only. Map and Set have no
+// Node-API of their own, so their methods (and Array.from) are called on
+// each element. Objects are filled by defining the properties of a chunk of
+// elements in a single call and read by their own enumerable string keys.
+// Elements are converted in a handle scope per chunk of kChunkSize, except
+// those holding handles, which must stay in the scope of the caller.
+
+// a global constructor such as Map, nullptr if it can't be read
+inline napi_value GlobalOf(napi_env env, const char *name) {
+  napi_value global, value;
+  if (napi_get_global(env, &global) != napi_ok ||
+      napi_get_named_property(env, global, name, &value) != napi_ok) {
+    return nullptr;
+  }
+  return value;
+}
+
+inline bool IsInstanceOf(napi_env env, napi_value value, const char *name) {
+  napi_value ctor = GlobalOf(env, name);
+  bool result = false;
+  return ctor != nullptr &&
+         napi_instanceof(env, value, ctor, &result) == napi_ok && result;
+}
+
+// fills a new collection, created in the scope of the caller, with [k0, v0,
+// k1, v1, ...] / [v0, v1, ...] converted in a handle scope per chunk
+class CollectionFiller {
+ public:
+  CollectionFiller(Napi::Env env, CollectionKind kind)
+      : _env(env), _kind(kind) {
+    Create();
+    napi_open_handle_scope(env, &_scope);
+  }
+  CollectionFiller(const CollectionFiller &) = delete;
+  CollectionFiller &operator=(const CollectionFiller &) = delete;
+  ~CollectionFiller() { Close(); }
+
+  void Add(napi_value value) {
+    _values[_count++] = value;
+    if (_count == kChunkSize) {
+      Flush();
+      Close();
+      napi_open_handle_scope(_env, &_scope);
+    }
+  }
+
+  Napi::Value Finish() {
+    Flush();
+    Close();
+    return Napi::Value(_env, _collection);
+  }
+
+ private:
+  void Create() {
+    if (_kind == kObjectCollection) {
+      napi_create_object(_env, &_collection);
+      return;
+    }
+    bool map = _kind == kMapCollection;
+    napi_value ctor = GlobalOf(_env, map ? "Map" : "Set");
+    if (ctor == nullptr ||
+        napi_new_instance(_env, ctor, 0, nullptr, &_collection) != napi_ok ||
+        napi_get_named_property(_env, _collection, map ? "set" : "add",
+                                &_method) != napi_ok) {
+      _collection = nullptr;
+    }
+  }
+
+  // the collection is nullptr once a call has failed
+  void Flush() {
+    if (_collection == nullptr || _count == 0) {
+      _count = 0;
+      return;
+    }
+    napi_status status = napi_ok;
+    if (_kind == kObjectCollection) {
+      // defined, so __proto__ is an own property too
+      napi_property_descriptor descriptors[kChunkSize / 2];
+      size_t count = _count / 2;
+      for (size_t i = 0; i < count; i++) {
+        descriptors[i] = napi_property_descriptor();
+        descriptors[i].name = _values[i * 2];
+        descriptors[i].value = _values[i * 2 + 1];
+        descriptors[i].attributes = static_cast<napi_property_attributes>(
+            napi_writable | napi_enumerable | napi_configurable);
+      }
+      status = napi_define_properties(_env, _collection, count, descriptors);
+    } else {
+      size_t step = _kind == kSetCollection ? 1 : 2;
+      for (size_t i = 0; status == napi_ok && i + step <= _count; i += step) {
+        napi_value result;
+        status = napi_call_function(_env, _collection, _method, step,
+                                    &_values[i], &result);
+      }
+    }
+    if (status != napi_ok) {
+      _collection = nullptr;
+    }
+    _count = 0;
+  }
+
+  void Close() {
+    if (_scope != nullptr) {
+      napi_close_handle_scope(_env, _scope);
+      _scope = nullptr;
+    }
+  }
+
+  Napi::Env _env;
+  CollectionKind _kind;
+  napi_value _collection = nullptr;
+  napi_value _method = nullptr;
+  napi_handle_scope _scope = nullptr;
+  napi_value _values[kChunkSize];
+  size_t _count = 0;
+};
+
+// receives the elements read from a collection, after its size
+class CollectionSink {
+ public:
+  virtual ~CollectionSink() = default;
+
+  // plain objects are read by their own enumerable string keys, Maps and
+  // Sets through Array.from
+  bool Drain(napi_env env, CollectionKind kind, napi_value collection,
+             bool holds_handles) {
+    Napi::Value value(env, collection);
+    JSType type = TypeOf(value, true);
+    napi_value list = collection;
+    if (kind == kObjectCollection) {
+      bool is_dataview = false;
+      if (type != JSType::kObject ||
+          napi_is_dataview(env, collection, &is_dataview) != napi_ok ||
+          is_dataview || IsInstanceOf(env, collection, "Map") ||
+          IsInstanceOf(env, collection, "Set") ||
+          napi_get_all_property_names(
+              env, collection, napi_key_own_only,
+              static_cast<napi_key_filter>(napi_key_enumerable |
+                                           napi_key_skip_symbols),
+              napi_key_numbers_to_strings, &list) != napi_ok) {
+        return false;
+      }
+    } else if (kind == kMapCollection || type != JSType::kArray) {
+      napi_value array = GlobalOf(env, "Array");
+      napi_value from;
+      if (type != JSType::kObject ||
+          !IsInstanceOf(env, collection,
+                        kind == kMapCollection ? "Map" : "Set") ||
+          array == nullptr ||
+          napi_get_named_property(env, array, "from", &from) != napi_ok ||
+          napi_call_function(env, array, from, 1, &collection, &list) !=
+              napi_ok) {
+        return false;
+      }
+    }
+    uint32_t len = 0;
+    if (napi_get_array_length(env, list, &len) != napi_ok) {
+      return false;
+    }
+    Reserve(len);
+    ChunkScope scope(env, !holds_handles);
+    for (uint32_t i = 0; i < len; i++) {
+      scope.Next();
+      napi_value item[2];
+      size_t count = kind == kSetCollection ? 1 : 2;
+      napi_status status = napi_get_element(env, list, i, &item[0]);
+      if (kind == kObjectCollection && status == napi_ok) {
+        status = napi_get_property(env, collection, item[0], &item[1]);
+      } else if (kind == kMapCollection && status == napi_ok) {
+        napi_value entry = item[0];
+        status = napi_get_element(env, entry, 0, &item[0]);
+        if (status == napi_ok) {
+          status = napi_get_element(env, entry, 1, &item[1]);
+        }
+      }
+      if (status != napi_ok || !Add(env, item, count)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+ protected:
+  virtual void Reserve(size_t size) = 0;
+  virtual bool Add(napi_env env, napi_value *values, size_t count) = 0;
+};
+
+// string keys become a plain object, other keys (and JSMap) a Map
+template <typename M>
+struct MapTransformer {
+  using K = typename M::key_type;
+  using V = typename M::mapped_type;
+
+  static constexpr JSType kJSType = JSType::kObject;
+
+  // own enumerable string keys of a plain object, not an array, a typed
+  // array, a Map or a Set
+  static std::optional<M> FromObject(Napi::Value value) {
+    return Drain(value, kObjectCollection);
+  }
+
+  static Napi::Value ToObject(Napi::Env env, M map) {
+    return Fill(env, std::move(map), kObjectCollection);
+  }
+
+  static std::optional<M> FromMap(Napi::Value value) {
+    return Drain(value, kMapCollection);
+  }
+
+  static std::optional<M> Drain(Napi::Value value, CollectionKind kind) {
+    struct Sink : CollectionSink {
+      M result;
+
+      void Reserve(size_t size) override { ReserveFor(result, size); }
+
+      bool Add(napi_env env, napi_value *values, size_t count) override {
+        for (size_t i = 0; i + 1 < count; i += 2) {
+          std::optional<K> k =
+              ValueTransformer<K>::FromJS(Napi::Value(env, values[i]));
+          std::optional<V> v =
+              ValueTransformer<V>::FromJS(Napi::Value(env, values[i + 1]));
+          if (!k.has_value() || !v.has_value()) {
+            return false;
+          }
+          result.emplace(std::move(*k), std::move(*v));
+        }
+        return true;
+      }
+    } sink;
+    if (!sink.Drain(value.Env(), kind, value,
+                    holds_handles<K>::Get() || holds_handles<V>::Get())) {
+      return {};
+    }
+    return std::move(sink.result);
+  }
+
+  static Napi::Value ToMap(Napi::Env env, M map) {
+    return Fill(env, std::move(map), kMapCollection);
+  }
+
+  static Napi::Value Fill(Napi::Env env, M map, CollectionKind kind) {
+    CollectionFiller filler(env, kind);
+    for (auto &[key, item] : map) {
+      filler.Add(ValueTransformer<K>::ToJS(env, key));
+      filler.Add(ValueTransformer<V>::ToJS(env, std::move(item)));
+    }
+    return filler.Finish();
+  }
+
+  static std::optional<M> FromJS(Napi::Value value) {
+    if constexpr (std::is_same_v<K, std::string>) {
+      return FromObject(value);
+    } else {
+      return FromMap(value);
+    }
+  }
+
+  static Napi::Value ToJS(Napi::Env env, M map) {
+    if constexpr (std::is_same_v<K, std::string>) {
+      return ToObject(env, std::move(map));
+    } else {
+      return ToMap(env, std::move(map));
+    }
+  }
+};
+
+// a JS Set, or an array when converted from JS
+template <typename S>
+struct SetTransformer {
+  using T = typename S::value_type;
+
+  static constexpr JSType kJSType = JSType::kObject | JSType::kArray;
+
+  static std::optional<S> FromJS(Napi::Value value) {
+    struct Sink : CollectionSink {
+      S result;
+
+      void Reserve(size_t size) override { ReserveFor(result, size); }
+
+      bool Add(napi_env env, napi_value *values, size_t count) override {
+        for (size_t i = 0; i < count; i++) {
+          std::optional<T> item =
+              ValueTransformer<T>::FromJS(Napi::Value(env, values[i]));
+          if (!item.has_value()) {
+            return false;
+          }
+          result.insert(std::move(*item));
+        }
+        return true;
+      }
+    } sink;
+    if (!sink.Drain(value.Env(), kSetCollection, value,
+                    holds_handles<T>::Get())) {
+      return {};
+    }
+    return std::move(sink.result);
+  }
+
+  static Napi::Value ToJS(Napi::Env env, S set) {
+    CollectionFiller filler(env, kSetCollection);
+    for (const T &item : set) {
+      filler.Add(ValueTransformer<T>::ToJS(env, item));
+    }
+    return filler.Finish();
+  }
+};
+
+template <typename K, typename V, typename C, typename A>
+struct holds_handles<std::map<K, V, C, A>> {
+  static bool Get() {
+    return holds_handles<K>::Get() || holds_handles<V>::Get();
+  }
+};
+
+template <typename K, typename V, typename H, typename E, typename A>
+struct holds_handles<std::unordered_map<K, V, H, E, A>> {
+  static bool Get() {
+    return holds_handles<K>::Get() || holds_handles<V>::Get();
+  }
+};
+
+template <typename M>
+struct holds_handles<JSMap<M>> : holds_handles<M> {};
+
+template <typename T, typename C, typename A>
+struct holds_handles<std::set<T, C, A>> : holds_handles<T> {};
+
+template <typename T, typename H, typename E, typename A>
+struct holds_handles<std::unordered_set<T, H, E, A>> : holds_handles<T> {};
+
+}  // namespace details
+
+template <typename K, typename V, typename C, typename A>
+struct ValueTransformer<std::map<K, V, C, A>>
+    : details::MapTransformer<std::map<K, V, C, A>> {};
+
+template <typename K, typename V, typename H, typename E, typename A>
+struct ValueTransformer<std::unordered_map<K, V, H, E, A>>
+    : details::MapTransformer<std::unordered_map<K, V, H, E, A>> {};
+
+template <typename M>
+struct ValueTransformer<JSMap<M>> {
+  static constexpr JSType kJSType = JSType::kObject;
+
+  static std::optional<JSMap<M>> FromJS(Napi::Value value) {
+    return details::MapTransformer<JSMap<M>>::FromMap(value);
+  }
+
+  static Napi::Value ToJS(Napi::Env env, JSMap<M> map) {
+    return details::MapTransformer<JSMap<M>>::ToMap(env, std::move(map));
+  }
+};
+
+template <typename T, typename C, typename A>
+struct ValueTransformer<std::set<T, C, A>>
+    : details::SetTransformer<std::set<T, C, A>> {};
+
+template <typename T, typename H, typename E, typename A>
+struct ValueTransformer<std::unordered_set<T, H, E, A>>
+    : details::SetTransformer<std::unordered_set<T, H, E, A>> {};
+
+template <>
+struct ValueTransformer<ArrayBuffer> {
+  static constexpr JSType kJSType = JSType::kObject;
+
+  static std::optional<ArrayBuffer> FromJS(Napi::Value value) {
+    void *data = nullptr;
+    size_t length = 0;
+    if (napi_get_arraybuffer_info(value.Env(), value, &data, &length) !=
+        napi_ok) {
+      return {};
+    }
+    return ArrayBuffer(static_cast<char *>(data),
+                       static_cast<char *>(data) + length);
+  }
+
+  static Napi::Value ToJS(Napi::Env env, ArrayBuffer arr) {
+    ArrayBuffer *arr_ptr = new ArrayBuffer(std::move(arr));
+    details::AdjustExternalMemory(env, details::BufferSlack(*arr_ptr));
+    return Napi::ArrayBuffer::New(
+        env, arr_ptr->data(), arr_ptr->size(),
+        [](napi_env env, void *, void *hint) {
+          ArrayBuffer *arr_ptr = static_cast<ArrayBuffer *>(hint);
+          details::AdjustExternalMemory(env, -details::BufferSlack(*arr_ptr));
+          delete arr_ptr;
+        },
+        arr_ptr);
+  }
+};
+
+template <typename E, napi_typedarray_type type>
+struct ValueTransformer<TypedArrayOf<E, type>> {
+ private:
+  using T = TypedArrayOf<E, type>;
+
+ public:
+  static constexpr JSType kJSType = JSType::kTypedArray;
+
+  static std::optional<T> FromJS(Napi::Value value) {
+    napi_typedarray_type actual;
+    size_t length = 0;
+    void *data = nullptr;
+    if (napi_get_typedarray_info(value.Env(), value, &actual, &length, &data,
+                                 nullptr, nullptr) != napi_ok ||
+        actual != type) {
+      return {};
+    }
+    E *elements = static_cast<E *>(data);
+    return T(elements, elements + length);
+  }
+
+  static Napi::Value ToJS(Napi::Env env, T arr) {
+    T *arr_ptr = new T(std::move(arr));
+    details::AdjustExternalMemory(env, details::BufferSlack(*arr_ptr));
+    Napi::ArrayBuffer buf = Napi::ArrayBuffer::New(
+        env, arr_ptr->data(), arr_ptr->size() * sizeof(E),
+        [](napi_env env, void *, void *hint) {
+          T *arr_ptr = static_cast<T *>(hint);
+          details::AdjustExternalMemory(env, -details::BufferSlack(*arr_ptr));
+          delete arr_ptr;
+        },
+        arr_ptr);
+    return Napi::TypedArrayOf<E>::New(env, arr_ptr->size(), buf, 0, type);
+  }
+};
+
+namespace details {
+// indexed by SharedBufferHelperIndex, see EnvState::SharedBufferHelper
+enum SharedBufferHelperIndex : uint32_t { kViewSharedBuffer, kNotifyShared };
+
+// the JS side of a SharedBuffer, deleted once every copy of the buffer is
+// gone and its thread-safe function is finalized
+struct SharedBufferContext {
+  std::mutex mutex;
+  // nullptr once finalized
+  napi_env env = nullptr;
+  napi_ref buffer = nullptr;
+  // int32 indices to notify with the next call on the JS thread
+  std::vector<uint32_t> pending;
+  // set once the last copy is gone, before the thread-safe function is
+  // released
+  bool released = false;
+
+  // the memory of the SharedArrayBuffer, which may be freed with the env.
+  // Copies still alive when the env is finalized get the memory moved into
+  // `detached`, waiting for accesses in progress, which wait for the move.
+  std::atomic<char *> data{nullptr};
+  size_t size = 0;
+  std::unique_ptr<char[]> detached;
+  std::atomic<uint32_t> accesses{0};
+  std::atomic<bool> moving{false};
+};
+
+// an access to the memory of a SharedBuffer, which isn't moved meanwhile
+class SharedAccess {
+ public:
+  NAPI_DISALLOW_ASSIGN_COPY(SharedAccess)
+
+  explicit SharedAccess(SharedBufferContext &context) : _context(context) {
+    while (true) {
+      _context.accesses.fetch_add(1);
+      if (!_context.moving.load()) {
+        break;
+      }
+      _context.accesses.fetch_sub(1);
+      while (_context.moving.load()) {
+        std::this_thread::yield();
+      }
+    }
+  }
+
+  ~SharedAccess() { _context.accesses.fetch_sub(1); }
+
+  char *data() const { return _context.data.load(std::memory_order_relaxed); }
+
+ private:
+  SharedBufferContext &_context;
+};
+
+class SharedMemory {
+ public:
+  NAPI_DISALLOW_ASSIGN_COPY(SharedMemory)
+
+  static void CallJS(Napi::Env env, Napi::Function notify,
+                     SharedBufferContext *context, void *) {
+    if (env == nullptr) {
+      return;
+    }
+    std::vector<napi_value> args(1);
+    {
+      std::lock_guard<std::mutex> lock(context->mutex);
+      args.reserve(context->pending.size() + 1);
+      for (uint32_t index : context->pending) {
+        args.push_back(Napi::Number::New(env, index));
+      }
+      context->pending.clear();
+    }
+    napi_get_reference_value(env, context->buffer, &args[0]);
+    notify.Call(args);
+  }
+
+  // on the JS thread, either after the last copy released the thread-safe
+  // function or when the env is torn down
+  static void Finalize(Napi::Env env,
+                       std::shared_ptr<SharedBufferContext> *holder,
+                       SharedBufferContext *context) {
+    {
+      std::lock_guard<std::mutex> lock(context->mutex);
+      napi_delete_reference(env, context->buffer);
+      context->env = nullptr;
+      context->buffer = nullptr;
+      if (!context->released) {
+        Detach(*context);
+      }
+    }
+    delete holder;
+  }
+
+  // moves the memory out of the env, while it's still alive
+  static void Detach(SharedBufferContext &context) {
+    context.moving.store(true);
+    while (context.accesses.load() != 0) {
+      std::this_thread::yield();
+    }
+    context.detached.reset(new char[context.size]);
+    std::memcpy(context.detached.get(), context.data.load(), context.size);
+    context.data.store(context.detached.get());
+    context.moving.store(false);
+  }
+
+  using TSFN =
+      Napi::TypedThreadSafeFunction<SharedBufferContext, void, CallJS>;
+
+  SharedMemory(TSFN tsfn, std::shared_ptr<SharedBufferContext> context)
+      : tsfn(tsfn), context(std::move(context)) {}
+
+  ~SharedMemory() {
+    // the thread-safe function is gone once finalized with the env, which
+    // waits for this lock
+    std::lock_guard<std::mutex> lock(context->mutex);
+    context->released = true;
+    if (context->env != nullptr) {
+      tsfn.Release();
+    }
+  }
+
+  TSFN tsfn;
+  const std::shared_ptr<SharedBufferContext> context;
+};
+}  // namespace details
+
+inline SharedBuffer::SharedBuffer(std::shared_ptr<details::SharedMemory> memory)
+    : _memory(std::move(memory)) {}
+
+inline std::optional<SharedBuffer> SharedBuffer::Bind(Napi::Env env,
+                                                      Napi::Value buffer,
+                                                      size_t size) {
+  Napi::Function view_fn =
+      details::EnvState::SharedBufferHelper(env, details::kViewSharedBuffer);
+  if (view_fn.IsEmpty()) {
+    return {};
+  }
+  Napi::Value view = view_fn.Call({buffer, Napi::Number::New(env, size)});
+  napi_value array_buffer;
+  void *data = nullptr;
+  size_t length = 0;
+  if (view.IsEmpty() ||
+      napi_get_typedarray_info(env, view, nullptr, &length, &data,
+                               &array_buffer, nullptr) != napi_ok) {
+    return {};
+  }
+  // a bound SharedArrayBuffer is alive, so is its memory at this address.
+  // Another SharedArrayBuffer over the same memory gets a SharedBuffer of
+  // its own, converting back into it.
+  details::EnvState *state = details::EnvState::Of(env);
+  if (state != nullptr) {
+    auto found = state->shared_buffers.find(data);
+    std::shared_ptr<details::SharedMemory> memory =
+        found != state->shared_buffers.end() ? found->second.lock() : nullptr;
+    napi_value bound = nullptr;
+    bool same = false;
+    if (memory &&
+        napi_get_reference_value(env, memory->context->buffer, &bound) ==
+            napi_ok &&
+        bound != nullptr &&
+        napi_strict_equals(env, bound, array_buffer, &same) == napi_ok &&
+        same) {
+      return SharedBuffer(std::move(memory));
+    }
+  }
+  auto context = std::make_shared<details::SharedBufferContext>();
+  if (napi_create_reference(env, array_buffer, 1, &context->buffer) !=
+      napi_ok) {
+    return {};
+  }
+  context->env = env;
+  context->data.store(static_cast<char *>(data));
+  context->size = length;
+  details::SharedMemory::TSFN tsfn = details::SharedMemory::TSFN::New(
+      env,
+      details::EnvState::SharedBufferHelper(env, details::kNotifyShared),
+      "naah::SharedBuffer", 0, 1, context.get(), details::SharedMemory::Finalize,
+      new std::shared_ptr<details::SharedBufferContext>(context));
+  // pending notifications don't keep the process alive, like JS waiters
+  tsfn.Unref(env);
+  auto memory =
+      std::make_shared<details::SharedMemory>(tsfn, std::move(context));
+  if (state != nullptr) {
+    auto &buffers = state->shared_buffers;
+    if (buffers.size() >= state->shared_buffers_sweep) {
+      for (auto it = buffers.begin(); it != buffers.end();) {
+        it = it->second.expired() ? buffers.erase(it) : std::next(it);
+      }
+      state->shared_buffers_sweep = std::max<size_t>(16, buffers.size() * 2);
+    }
+    buffers[data] = memory;
+  }
+  return SharedBuffer(std::move(memory));
+}
+
+inline SharedBuffer SharedBuffer::New(Napi::Env env, size_t size) {
+  std::optional<SharedBuffer> buffer = Bind(env, env.Undefined(), size);
+  if (!buffer.has_value()) {
+    NAPI_THROW(Napi::Error::New(env, "failed to create SharedArrayBuffer"),
+               SharedBuffer());
+  }
+  return std::move(*buffer);
+}
+
+inline char *SharedBuffer::data() const NAPI_NOEXCEPT {
+  return _memory ? _memory->context->data.load() : nullptr;
+}
 
-  template <size_t... Is>
-  static std::vector<napi_value> ToVectorImpl([[maybe_unused]] Napi::Env env,
-                                              [[maybe_unused]] Tuple t,
-                                              std::index_sequence<Is...>) {
-    std::vector<napi_value> result(std::tuple_size_v<Tuple>);
-    ((result[Is] = ValueTransformer<std::tuple_element_t<Is, Tuple>>::ToJS(
-          env, std::move(std::get<Is>(t)))),
-     ...);
-    return result;
+inline size_t SharedBuffer::size() const NAPI_NOEXCEPT {
+  return _memory ? _memory->context->size : 0;
+}
+
+inline std::atomic<int32_t> *SharedBuffer::Int32At(char *data,
+                                                   size_t index) const
+    NAPI_NOEXCEPT {
+  using Int32 = std::atomic<int32_t>;
+  if (index >= _memory->context->size / sizeof(Int32)) {
+    return nullptr;
   }
+  void *address = data + index * sizeof(Int32);
+  if (reinterpret_cast<uintptr_t>(address) % alignof(Int32) != 0) {
+    return nullptr;
+  }
+  return static_cast<Int32 *>(address);
+}
 
- public:
-  static std::vector<napi_value> ToVector(Napi::Env env, Tuple t) {
-    return ToVectorImpl(env, std::move(t), std::index_sequence_for<Args...>{});
+inline std::optional<int32_t> SharedBuffer::Load(size_t index) const
+    NAPI_NOEXCEPT {
+  if (!_memory) {
+    return {};
+  }
+  details::SharedAccess access(*_memory->context);
+  std::atomic<int32_t> *value = Int32At(access.data(), index);
+  if (value == nullptr) {
+    return {};
   }
+  return value->load();
+}
 
-  static std::optional<Tuple> FromJS(Napi::Value value) {
-    if (!value.IsArray()) {
-      return {};
+inline bool SharedBuffer::Store(size_t index,
+                                int32_t value) const NAPI_NOEXCEPT {
+  if (!_memory) {
+    return false;
+  }
+  details::SharedAccess access(*_memory->context);
+  std::atomic<int32_t> *slot = Int32At(access.data(), index);
+  if (slot == nullptr) {
+    return false;
+  }
+  slot->store(value);
+  return true;
+}
+
+inline void SharedBuffer::Notify(size_t index) const {
+  details::SharedBufferContext &context = *_memory->context;
+  {
+    std::lock_guard<std::mutex> lock(context.mutex);
+    std::vector<uint32_t> &pending = context.pending;
+    if (context.env == nullptr ||
+        std::find(pending.begin(), pending.end(), index) != pending.end()) {
+      return;
+    }
+    pending.push_back(static_cast<uint32_t>(index));
+    if (pending.size() > 1) {
+      // a call is queued already
+      return;
     }
-    return details::ArgsConverter<Tuple>::Get(value.As<Napi::Array>(), 0);
   }
+  _memory->tsfn.NonBlockingCall();
+}
 
-  static Napi::Value ToJS(Napi::Env env, Tuple t) {
-    return std::apply(
-        [&](auto &&...elements) -> Napi::Array {
-          constexpr size_t size = sizeof...(elements);
+template <typename E, napi_typedarray_type type>
+inline Out<TypedArrayOf<E, type>>::Out(Napi::Env env) NAPI_NOEXCEPT
+    : _env(env) {}
 
-          Napi::Array result = Napi::Array::New(env, size);
+template <typename E, napi_typedarray_type type>
+inline E *Out<TypedArrayOf<E, type>>::data() const NAPI_NOEXCEPT {
+  return _data;
+}
 
-          std::vector<napi_value> vec = ToVector(env, std::move(t));
-          for (uint32_t i = 0; i < vec.size(); i++) {
-            result.Set(i, Napi::Value(env, vec[i]));
-          }
+template <typename E, napi_typedarray_type type>
+inline size_t Out<TypedArrayOf<E, type>>::size() const NAPI_NOEXCEPT {
+  return _size;
+}
 
-          return result;
-        },
-        t);
+template <typename E, napi_typedarray_type type>
+inline E &Out<TypedArrayOf<E, type>>::operator[](size_t index) const
+    NAPI_NOEXCEPT {
+  return _data[index];
+}
+
+template <typename E, napi_typedarray_type type>
+inline bool Out<TypedArrayOf<E, type>>::Resize(size_t length) {
+  if (_value != nullptr) {
+    return length == _size;
   }
-};
+  void *data = nullptr;
+  napi_value buffer;
+  napi_value value;
+  if (napi_create_arraybuffer(_env, length * sizeof(E), &data, &buffer) !=
+          napi_ok ||
+      napi_create_typedarray(_env, type, length, buffer, 0, &value) !=
+          napi_ok) {
+    return false;
+  }
+  _value = value;
+  _data = static_cast<E *>(data);
+  _size = length;
+  return true;
+}
 
-template <typename T>
-struct ValueTransformer<std::vector<T>> {
-  static std::optional<std::vector<T>> FromJS(Napi::Value value) {
-    if (!value.IsArray()) {
-      return {};
+template <typename E, napi_typedarray_type type>
+struct ValueTransformer<Out<TypedArrayOf<E, type>>> {
+  using T = Out<TypedArrayOf<E, type>>;
+
+  static constexpr JSType kJSType = JSType::kTypedArray | JSType::kUndefined;
+
+  static std::optional<T> FromJS(Napi::Value value) {
+    T out(value.Env());
+    if (value.IsUndefined()) {
+      return out;
     }
-    Napi::Array arr = value.As<Napi::Array>();
-    uint32_t len = arr.Length();
-    std::vector<T> result;
-    result.reserve(len);
-    for (uint32_t i = 0; i < len; i++) {
-      std::optional<T> item = ValueTransformer<T>::FromJS(arr.Get(i));
-      if (!item.has_value()) {
-        return {};
-      }
-      result.push_back(std::move(*item));
+    napi_typedarray_type actual;
+    void *data = nullptr;
+    if (napi_get_typedarray_info(value.Env(), value, &actual, &out._size,
+                                 &data, nullptr, nullptr) != napi_ok ||
+        actual != type) {
+      return {};
     }
-    return result;
+    out._value = value;
+    out._data = static_cast<E *>(data);
+    return out;
   }
 
-  static Napi::Value ToJS(Napi::Env env, std::vector<T> arr) {
-    Napi::Array result = Napi::Array::New(env, arr.size());
-    for (uint32_t i = 0; i < arr.size(); i++) {
-      result.Set(i, ValueTransformer<T>::ToJS(env, std::move(arr[i])));
+  // an empty typed array if it was never created
+  static Napi::Value ToJS(Napi::Env env, T out) {
+    if (out._value == nullptr && !out.Resize(0)) {
+      NAPI_THROW(Napi::Error::New(env, "failed to create typed array"),
+                 Napi::Value());
     }
-    return result;
+    return Napi::Value(env, out._value);
   }
 };
 
-template <>
-struct ValueTransformer<ArrayBuffer> {
-  static std::optional<ArrayBuffer> FromJS(Napi::Value value) {
-    if (!value.IsArrayBuffer()) {
+template <typename T>
+inline Lazy<T>::Lazy(Napi::Value value) NAPI_NOEXCEPT : _value(value) {}
+
+template <typename T>
+inline std::optional<T> &Lazy<T>::get() {
+  if (!_converted.has_value()) {
+    _converted.emplace(ValueTransformer<T>::FromJS(_value));
+  }
+  return *_converted;
+}
+
+template <typename T>
+inline Napi::Value Lazy<T>::value() const NAPI_NOEXCEPT {
+  return _value;
+}
+
+template <typename T>
+struct ValueTransformer<Lazy<T>> {
+  static constexpr JSType kJSType = details::js_type_of<T>::value;
+
+  // fails for undefined unless T takes it, so that std::optional<Lazy<T>> is
+  // empty for a missing argument
+  static std::optional<Lazy<T>> FromJS(Napi::Value value) {
+    if ((details::TypeOf(value, false) & kJSType) == JSType::kNone) {
       return {};
     }
-    Napi::ArrayBuffer buf = value.As<Napi::ArrayBuffer>();
-    return ArrayBuffer(static_cast<char *>(buf.Data()),
-                       static_cast<char *>(buf.Data()) + buf.ByteLength());
+    return Lazy<T>(value);
   }
 
-  static Napi::Value ToJS(Napi::Env env, ArrayBuffer arr) {
-    ArrayBuffer *arr_ptr = new ArrayBuffer(std::move(arr));
-    return Napi::ArrayBuffer::New(
-        env, arr_ptr->data(), arr_ptr->size(),
-        [](napi_env, void *, void *hint) {
-          delete static_cast<ArrayBuffer *>(hint);
-        },
-        arr_ptr);
+  static Napi::Value ToJS(Napi::Env, const Lazy<T> &lazy) {
+    return lazy._value;
   }
 };
 
-template <typename E, napi_typedarray_type type>
-struct ValueTransformer<TypedArrayOf<E, type>> {
- private:
-  using T = TypedArrayOf<E, type>;
+template <>
+struct ValueTransformer<SharedBuffer> {
+  static_assert(sizeof(std::atomic<int32_t>) == sizeof(int32_t) &&
+                    std::atomic<int32_t>::is_always_lock_free,
+                "int32 atomics must be shareable with JS");
 
- public:
-  static std::optional<T> FromJS(Napi::Value value) {
-    if (!value.IsTypedArray()) {
-      return {};
-    }
-    Napi::TypedArray arr = value.As<Napi::TypedArray>();
-    if (arr.TypedArrayType() != type) {
+  static constexpr JSType kJSType = JSType::kObject;
+
+  static std::optional<SharedBuffer> FromJS(Napi::Value value) {
+    if (value.IsUndefined()) {
       return {};
     }
-    Napi::TypedArrayOf<E> typed_arr = arr.As<Napi::TypedArrayOf<E>>();
-    return T(typed_arr->Data(), typed_arr->Data() + typed_arr->Length());
+    return SharedBuffer::Bind(value.Env(), value, 0);
   }
 
-  static Napi::Value ToJS(Napi::Env env, T arr) {
-    T *arr_ptr = new T(std::move(arr));
-    Napi::ArrayBuffer buf = Napi::ArrayBuffer::New(
-        env, arr_ptr->data(), arr_ptr->size() * sizeof(T),
-        [](napi_env, void *, void *hint) { delete static_cast<T *>(hint); },
-        arr_ptr);
-    return Napi::TypedArrayOf<E>::New(env, arr_ptr->size(), buf, 0, type);
+  static Napi::Value ToJS(Napi::Env env, const SharedBuffer &buffer) {
+    if (!buffer._memory || buffer._memory->context->env != env) {
+      return env.Undefined();
+    }
+    // the context is finalized on this thread, no need to lock
+    napi_value result;
+    napi_status status =
+        napi_get_reference_value(env, buffer._memory->context->buffer, &result);
+    NAPI_THROW_IF_FAILED(env, status, Napi::Value());
+    return Napi::Value(env, result);
   }
 };
 
@@ -721,16 +2637,54 @@ struct is_std_function : std::false_type {};
 template <typename Ret, typename... Args>
 struct is_std_function<std::function<Ret(Args...)>> : std::true_type {};
 
+// the typed array type of a column of T in batch calls, if any
+template <typename T>
+constexpr std::optional<napi_typedarray_type> ColumnType() {
+  if constexpr (std::is_same_v<T, float>) {
+    return napi_float32_array;
+  } else if constexpr (std::is_same_v<T, double>) {
+    return napi_float64_array;
+  } else if constexpr (!std::is_integral_v<T> || std::is_same_v<T, bool>) {
+    return {};
+  } else if constexpr (sizeof(T) == 1) {
+    return std::is_signed_v<T> ? napi_int8_array : napi_uint8_array;
+  } else if constexpr (sizeof(T) == 2) {
+    return std::is_signed_v<T> ? napi_int16_array : napi_uint16_array;
+  } else if constexpr (sizeof(T) == 4) {
+    return std::is_signed_v<T> ? napi_int32_array : napi_uint32_array;
+#if NAPI_VERSION > 5
+  } else if constexpr (sizeof(T) == 8) {
+    return std::is_signed_v<T> ? napi_bigint64_array : napi_biguint64_array;
+#endif
+  } else {
+    return {};
+  }
+}
+
+template <typename Args>
+struct columns_of;
+
+template <typename... Args>
+struct columns_of<std::tuple<Args...>> {
+  static constexpr bool value =
+      (ColumnType<remove_cvref_t<Args>>().has_value() && ...);
+};
+
 class Invoker {
  private:
   template <typename Ret, typename Callable>
   static Ret CallInternal(const Napi::CallbackInfo &info, Callable &&fn) {}
 
+  // Ret may be a reference, which is converted without copying if the
+  // transformer takes a const reference
   template <typename Ret>
   static Napi::Value ToJS(const Napi::CallbackInfo &info, Ret ret) {
-    if constexpr (details::is_result<Ret>::value) {
-      using T = typename result_type<Ret>::T;
-      using E = typename result_type<Ret>::E;
+    using Value = remove_cvref_t<Ret>;
+    ClassCacheScope<typename returned_classes<Value>::type> classes(
+        info.Env());
+    if constexpr (details::is_result<Value>::value) {
+      using T = typename result_type<Value>::T;
+      using E = typename result_type<Value>::E;
       if (ret.value.has_value()) {
         return ValueTransformer<T>::ToJS(info.Env(), std::move(*ret.value));
       } else {
@@ -738,8 +2692,10 @@ class Invoker {
             .ThrowAsJavaScriptException();
         return info.Env().Undefined();
       }
+    } else if constexpr (std::is_lvalue_reference_v<Ret>) {
+      return ValueTransformer<Value>::ToJS(info.Env(), ret);
     } else {
-      return ValueTransformer<Ret>::ToJS(info.Env(), std::move(ret));
+      return ValueTransformer<Value>::ToJS(info.Env(), std::move(ret));
     }
   }
 
@@ -761,6 +2717,20 @@ class Invoker {
 #endif
   }
 
+  template <bool with_info, typename Callable, typename Storage,
+            size_t... Is>
+  static decltype(auto) Apply(
+      [[maybe_unused]] const Napi::CallbackInfo &info, Callable &&fn,
+      [[maybe_unused]] Storage &args, std::index_sequence<Is...>) {
+    if constexpr (with_info) {
+      return std::invoke(std::forward<Callable>(fn), info,
+                         args.template Get<Is>()...);
+    } else {
+      return std::invoke(std::forward<Callable>(fn),
+                         args.template Get<Is>()...);
+    }
+  }
+
   template <typename Callable>
   static auto CallInternal(const Napi::CallbackInfo &info, Callable &&fn) {
     using Signature = get_signature<std::decay_t<Callable>>;
@@ -773,20 +2743,21 @@ class Invoker {
     using Args = typename std::conditional_t<
         head_is_cb_info, typename get_tuple_elements<OriginArgs>::rest,
         OriginArgs>;
+    using Storage = typename args_storage<Args>::type;
 
-    std::optional<Args> args = ArgsConverter<Args>::Get(info, 0);
-    if (!args.has_value()) {
+    CallArenaScope<has_call_arena<Args>::value> arena;
+    CallStatsScope<has_call_stats<Args>::value> stats(info.Length());
+    bool ok = true;
+    Storage args = Storage::Convert(info, 0, ok);
+    if (!ok) {
       NAPI_THROW(Napi::TypeError::New(info.Env(), "bad arguments"),
                  typename Signature::ret());
     }
+    stats.Converted();
 
-    if constexpr (head_is_cb_info) {
-      return std::apply(
-          std::forward<Callable>(fn),
-          std::tuple_cat(std::make_tuple(std::cref(info)), std::move(*args)));
-    } else {
-      return std::apply(std::forward<Callable>(fn), std::move(*args));
-    }
+    return Apply<head_is_cb_info>(
+        info, std::forward<Callable>(fn), args,
+        std::make_index_sequence<std::tuple_size_v<Args>>{});
   }
 
   template <typename Callable>
@@ -803,31 +2774,169 @@ class Invoker {
     using Args = typename std::conditional_t<
         head_is_cb_info, typename get_tuple_elements<OriginArgs>::rest,
         OriginArgs>;
+    using Storage = typename args_storage<Args>::type;
 
-    std::optional<Args> args = ArgsConverter<Args>::Get(info, 0);
-    if (!args.has_value()) {
+    CallArenaScope<has_call_arena<Args>::value> arena;
+    CallStatsScope<has_call_stats<Args>::value> stats(info.Length());
+    bool ok = true;
+    Storage args = Storage::Convert(info, 0, ok);
+    if (!ok) {
       NAPI_THROW(Napi::TypeError::New(info.Env(), "bad arguments"),
                  typename std::conditional_t<ret_is_void, void, Napi::Value>());
     }
+    stats.Converted();
+
+    using Indices = std::make_index_sequence<std::tuple_size_v<Args>>;
+    if constexpr (ret_is_void) {
+      return Apply<head_is_cb_info>(info, std::forward<Callable>(fn), args,
+                                    Indices{});
+    } else {
+      return ToJS<Ret>(info, Apply<head_is_cb_info>(
+                                 info, std::forward<Callable>(fn), args,
+                                 Indices{}));
+    }
+  }
+
+  template <typename Callable>
+  static Napi::Value CallBatch(const Napi::CallbackInfo &info, Callable fn) {
+    using Signature = get_signature<std::decay_t<Callable>>;
+    using OriginArgs = typename Signature::args;
+    using Ret = typename Signature::ret;
+    using Value = remove_cvref_t<Ret>;
+
+    constexpr bool head_is_cb_info =
+        std::is_same_v<typename get_tuple_elements<OriginArgs>::head,
+                       const Napi::CallbackInfo &>;
+    using Args = typename std::conditional_t<
+        head_is_cb_info, typename get_tuple_elements<OriginArgs>::rest,
+        OriginArgs>;
+    using Storage = typename args_storage<Args>::type;
+    using Indices = std::make_index_sequence<std::tuple_size_v<Args>>;
+
+    Napi::Env env = info.Env();
+    if constexpr (std::tuple_size_v<Args> != 0 && columns_of<Args>::value &&
+                  (std::is_void_v<Ret> || ColumnType<Value>().has_value())) {
+      if (info.Length() != 0 && info[0].IsTypedArray()) {
+        return CallColumns<head_is_cb_info, Ret>(info, fn,
+                                                 static_cast<Args *>(nullptr),
+                                                 Indices{});
+      }
+    }
 
-    if constexpr (head_is_cb_info) {
-      if constexpr (ret_is_void) {
-        return std::apply(
-            std::forward<Callable>(fn),
-            std::tuple_cat(std::make_tuple(std::cref(info)), std::move(*args)));
+    uint32_t length = 0;
+    if (napi_get_array_length(env, info[0], &length) != napi_ok) {
+      NAPI_THROW(Napi::TypeError::New(env, "bad arguments"), Napi::Value());
+    }
+    Napi::Array rows = info[0].As<Napi::Array>();
+    Napi::Array results;
+    if constexpr (!std::is_void_v<Ret>) {
+      results = Napi::Array::New(env, length);
+    }
+    ClassCacheScope<typename returned_classes<Value>::type> classes(env);
+    ChunkScope scope(env);
+    for (uint32_t i = 0; i < length; i++) {
+      scope.Next();
+      CallArenaScope<has_call_arena<Args>::value> arena;
+      auto bad_arguments = [&] {
+        return Napi::TypeError::New(
+            env, "bad arguments at index " + std::to_string(i));
+      };
+      Napi::Value row = rows.Get(i);
+      if (!row.IsArray()) {
+        NAPI_THROW(bad_arguments(), Napi::Value());
+      }
+      constexpr bool kStats = has_call_stats<Args>::value;
+      CallStatsScope<kStats> stats(kStats ? row.As<Napi::Array>().Length()
+                                          : 0);
+      bool ok = true;
+      Storage args = Storage::Convert(row.As<Napi::Array>(), 0, ok);
+      if (!ok) {
+        NAPI_THROW(bad_arguments(), Napi::Value());
+      }
+      stats.Converted();
+      if constexpr (std::is_void_v<Ret>) {
+        Apply<head_is_cb_info>(info, fn, args, Indices{});
       } else {
-        return ToJS<Ret>(
-            info, std::apply(std::forward<Callable>(fn),
-                             std::tuple_cat(std::make_tuple(std::cref(info)),
-                                            std::move(*args))));
+        results.Set(i, ToJS<Ret>(info, Apply<head_is_cb_info>(info, fn, args,
+                                                              Indices{})));
+      }
+      // thrown by fn, its result or its conversion, the rest is not called
+      if (env.IsExceptionPending()) {
+        return Napi::Value();
       }
+    }
+    if constexpr (std::is_void_v<Ret>) {
+      return env.Undefined();
     } else {
-      if constexpr (ret_is_void) {
-        return std::apply(std::forward<Callable>(fn), std::move(*args));
+      return results;
+    }
+  }
+
+  // the columns are used in place and results are written into a new typed
+  // array, nothing is converted per element
+  template <bool with_info, typename Ret, typename Callable, typename... Args,
+            size_t... Is>
+  static Napi::Value CallColumns(const Napi::CallbackInfo &info, Callable &fn,
+                                 std::tuple<Args...> *,
+                                 std::index_sequence<Is...>) {
+    Napi::Env env = info.Env();
+    constexpr size_t kColumns = sizeof...(Args);
+    void *columns[kColumns];
+    size_t length = 0;
+    for (size_t i = 0; i < kColumns; i++) {
+      constexpr napi_typedarray_type types[] = {
+          *ColumnType<remove_cvref_t<Args>>()...};
+      napi_typedarray_type type;
+      size_t column_length = 0;
+      if (i >= info.Length() ||
+          napi_get_typedarray_info(env, info[i], &type, &column_length,
+                                   &columns[i], nullptr,
+                                   nullptr) != napi_ok ||
+          type != types[i] || (i > 0 && column_length != length)) {
+        NAPI_THROW(Napi::TypeError::New(
+                       env, "bad column at index " + std::to_string(i)),
+                   Napi::Value());
+      }
+      length = column_length;
+    }
+
+    auto call = [&](size_t row) -> decltype(auto) {
+      if constexpr (with_info) {
+        return std::invoke(
+            fn, info, static_cast<remove_cvref_t<Args> *>(columns[Is])[row]...);
       } else {
-        return ToJS<Ret>(
-            info, std::apply(std::forward<Callable>(fn), std::move(*args)));
+        return std::invoke(
+            fn, static_cast<remove_cvref_t<Args> *>(columns[Is])[row]...);
+      }
+    };
+    if constexpr (std::is_void_v<Ret>) {
+      for (size_t row = 0; row < length; row++) {
+        call(row);
+        if (env.IsExceptionPending()) {
+          return Napi::Value();
+        }
+      }
+      return env.Undefined();
+    } else {
+      using Value = remove_cvref_t<Ret>;
+      void *data = nullptr;
+      napi_value buffer;
+      napi_value result;
+      napi_status status = napi_create_arraybuffer(env, length * sizeof(Value),
+                                                   &data, &buffer);
+      if (status == napi_ok) {
+        status = napi_create_typedarray(env, *ColumnType<Value>(), length,
+                                        buffer, 0, &result);
+      }
+      NAPI_THROW_IF_FAILED(env, status, Napi::Value());
+      Value *out = static_cast<Value *>(data);
+      for (size_t row = 0; row < length; row++) {
+        out[row] = call(row);
+        if (env.IsExceptionPending()) {
+          return Napi::Value();
+        }
       }
+      return Napi::Value(env, result);
     }
   }
 
@@ -849,14 +2958,121 @@ class Invoker {
     return CallJS(info, fn);
   }
 
-  template <class T, typename Ret, typename... Args>
-  static auto InstanceCall(T *c, Ret (T::*m)(Args...)) {
-    return [=](Args... args) -> Ret { return (c->*m)(std::move(args)...); };
+  // fn called over an array of argument arrays, or over typed arrays holding
+  // a column per argument when they are all numbers
+  template <auto fn>
+  static Napi::Value BatchCallback(const Napi::CallbackInfo &info) {
+    return WrapCallback(info, [&] { return CallBatch(info, fn); });
+  }
+
+  // the lambda takes references, so by-value parameters of the method are
+  // moved only once, from the converted arguments. It refers to the
+  // receiver of the caller, an lvalue alive for the whole call.
+  template <auto m, class T>
+  static auto InstanceCall(T *&c) {
+    return InstanceCall<m>(c, m);
+  }
+
+  template <auto m, class T, typename Ret, typename... Args>
+  static auto InstanceCall(T *&c, Ret (T::*)(Args...)) {
+    return [&](Args &&...args) -> Ret {
+      return (c->*m)(std::forward<Args>(args)...);
+    };
+  }
+
+  template <auto m, class T, typename Ret, typename... Args>
+  static auto InstanceCall(T *&c, Ret (T::*)(Args...) const) {
+    return [&](Args &&...args) -> Ret {
+      return (c->*m)(std::forward<Args>(args)...);
+    };
+  }
+};
+
+// A callable turned into a JS function. Stateless lambdas (convertible to a
+// function pointer, called as const) are called from a static of their type
+// by a static callback like Function::New<fn>, other callables live in a
+// single allocation freed with the function, along with the data of the
+// callback.
+template <typename Callable>
+struct Closure {
+  using Signature = get_signature<Callable>;
+
+  template <typename T>
+  struct is_const_call : std::false_type {};
+
+  template <typename C, typename R, typename... Args>
+  struct is_const_call<R (C::*)(Args...) const> : std::true_type {};
+
+  template <typename T, typename Enable = void>
+  struct has_const_call : std::false_type {};
+
+  template <typename T>
+  struct has_const_call<T, std::void_t<decltype(&T::operator())>>
+      : is_const_call<decltype(&T::operator())> {};
+
+  template <typename Ret, typename Args>
+  struct pointer_of;
+
+  template <typename Ret, typename... Args>
+  struct pointer_of<Ret, std::tuple<Args...>> {
+    using type = Ret (*)(Args...);
+  };
+
+  static constexpr bool kStateless =
+      std::is_empty_v<Callable> &&
+      has_const_call<Callable>::value &&
+      std::is_convertible_v<
+          Callable, typename pointer_of<typename Signature::ret,
+                                        typename Signature::args>::type>;
+
+  Callable fn;
+  void *data;
+
+  // every stateless lambda of a type is the same, the first one is kept. It's
+  // initialized once and never written again, since the envs of workers call
+  // it from their own threads. Function::New passes fn before any call.
+  static const Callable &Stateless(Callable *fn = nullptr) {
+    static_assert(std::is_empty_v<Callable>,
+                  "only callables without state are shared by their type");
+    static const Callable stateless(std::move(*fn));
+    return stateless;
+  }
+
+  static std::conditional_t<std::is_void_v<typename Signature::ret>, void,
+                            Napi::Value>
+  StatelessCallback(const Napi::CallbackInfo &info) {
+    return Invoker::CallJS(info, Stateless());
+  }
+
+  static napi_value Callback(napi_env env, napi_callback_info cb_info) {
+#ifdef NAPI_CPP_EXCEPTIONS
+    try {
+      return Call(env, cb_info);
+    } catch (const Napi::Error &e) {
+      e.ThrowAsJavaScriptException();
+      return nullptr;
+    }
+#else
+    return Call(env, cb_info);
+#endif
+  }
+
+  static void Finalize(napi_env, void *data, void *) {
+    delete static_cast<Closure *>(data);
   }
 
-  template <class T, typename Ret, typename... Args>
-  static auto InstanceCall(T *c, Ret (T::*m)(Args...) const) {
-    return [=](Args... args) -> Ret { return (c->*m)(std::move(args)...); };
+ private:
+  static napi_value Call(napi_env env, napi_callback_info cb_info) {
+    Napi::CallbackInfo info(env, cb_info);
+    Closure *closure = static_cast<Closure *>(info.Data());
+    info.SetData(closure->data);
+    if constexpr (std::is_void_v<decltype(Invoker::CallJS(info,
+                                                          closure->fn))>) {
+      Invoker::CallJS(info, closure->fn);
+      return nullptr;
+    } else {
+      return Invoker::CallJS(info, closure->fn);
+    }
   }
 };
 
@@ -896,19 +3112,238 @@ inline Napi::Function Function::New(Napi::Env env, const std::string &utf8name,
 template <typename Callable>
 inline Napi::Function Function::New(Napi::Env env, Callable fn,
                                     const char *utf8name, void *data) {
-  return Napi::Function::New(
-      env,
-      [fn = std::move(fn)](const Napi::CallbackInfo &info) -> auto {
-        return details::Invoker::CallJS(info, fn);
-      },
-      utf8name, data);
+  if constexpr (Closure<Callable>::kStateless) {
+    Closure<Callable>::Stateless(&fn);
+    return Napi::Function::New<Closure<Callable>::StatelessCallback>(
+        env, utf8name, data);
+  } else {
+#if NAPI_VERSION > 4
+    Closure<Callable> *closure = new Closure<Callable>{std::move(fn), data};
+    napi_value value;
+    napi_status status =
+        napi_create_function(env, utf8name, NAPI_AUTO_LENGTH,
+                             Closure<Callable>::Callback, closure, &value);
+    if (status == napi_ok) {
+      status = napi_add_finalizer(env, value, closure,
+                                  Closure<Callable>::Finalize, nullptr,
+                                  nullptr);
+    }
+    if (status != napi_ok) {
+      delete closure;
+      NAPI_THROW_IF_FAILED(env, status, Napi::Function());
+    }
+    return Napi::Function(env, value);
+#else
+    return Napi::Function::New(
+        env,
+        [fn = std::move(fn)](const Napi::CallbackInfo &info) -> auto {
+          return details::Invoker::CallJS(info, fn);
+        },
+        utf8name, data);
+#endif
+  }
+}
+
+template <typename Callable>
+inline Napi::Function Function::New(Napi::Env env, Callable fn,
+                                    const std::string &utf8name, void *data) {
+  return New(env, fn, utf8name.c_str(), data);
+}
+
+// The view of a slot holding T in the memory of a fast function, see
+// FastFunction
+template <typename T>
+constexpr const char *FastView() {
+  if constexpr (std::is_same_v<T, bool>) {
+    return "u8";
+  } else if constexpr (std::is_same_v<T, float>) {
+    return "f32";
+  } else if constexpr (std::is_same_v<T, double>) {
+    return "f64";
+  } else if constexpr (sizeof(T) == 1) {
+    return std::is_signed_v<T> ? "i8" : "u8";
+  } else if constexpr (sizeof(T) == 2) {
+    return std::is_signed_v<T> ? "i16" : "u16";
+  } else if constexpr (sizeof(T) == 4) {
+    return std::is_signed_v<T> ? "i32" : "u32";
+  } else {
+    return std::is_signed_v<T> ? "i64" : "u64";
+  }
 }
 
-template <typename Callable>
-inline Napi::Function Function::New(Napi::Env env, Callable fn,
-                                    const std::string &utf8name, void *data) {
-  return New(env, fn, utf8name.c_str(), data);
-}
+// A function of numbers called without converting arguments: a JS stub
+// writes them into 8 byte slots of an ArrayBuffer of the function, calls the
+// native entry without arguments, which reads them in place and writes the
+// result into the slot after them, then reads it back. Arguments of other
+// types go through the checked function, which is also used alone where
+// scripts can't be compiled.
+template <auto fn>
+class FastFunction {
+  using Signature = get_signature<decltype(fn)>;
+  using Ret = typename Signature::ret;
+  using Args = typename Signature::args;
+  static constexpr size_t kArgs = std::tuple_size_v<Args>;
+  static constexpr size_t kSlot = 8;
+
+  template <typename T>
+  static constexpr bool is_fast_v =
+      std::is_arithmetic_v<T> && sizeof(T) <= kSlot;
+
+  template <typename... Ts>
+  static constexpr bool AllFast(std::tuple<Ts...> *) {
+    return (is_fast_v<Ts> && ...);
+  }
+
+  static_assert(AllFast(static_cast<Args *>(nullptr)) &&
+                    (std::is_void_v<Ret> || is_fast_v<Ret>),
+                "fast functions take and return numbers and booleans only");
+
+ public:
+  static Napi::Value New(Napi::Env env, const char *utf8name) {
+    Napi::Function checked = Function::New<fn>(env, utf8name);
+    if (checked.IsEmpty()) {
+      return Napi::Value();
+    }
+
+    napi_value source;
+    napi_value factory;
+    napi_status status = napi_create_string_utf8(
+        env, Source(static_cast<Args *>(nullptr)).c_str(), NAPI_AUTO_LENGTH,
+        &source);
+    NAPI_THROW_IF_FAILED(env, status, Napi::Value());
+    if (napi_run_script(env, source, &factory) != napi_ok) {
+      // e.g. code generation from strings is disallowed
+      napi_value error;
+      napi_get_and_clear_last_exception(env, &error);
+      return checked;
+    }
+
+    void *data = nullptr;
+    napi_value buffer;
+    napi_value native;
+    status = napi_create_arraybuffer(env, (kArgs + 1) * kSlot, &data, &buffer);
+    if (status == napi_ok) {
+      status = napi_create_function(env, utf8name, NAPI_AUTO_LENGTH, Callback,
+                                    data, &native);
+    }
+    NAPI_THROW_IF_FAILED(env, status, Napi::Value());
+    return Napi::Function(env, factory)
+        .Call({native, checked, buffer, Napi::String::New(env, utf8name)});
+  }
+
+ private:
+  template <typename T>
+  static std::string Slot(size_t slot) {
+    return std::string(FastView<T>()) + "[" +
+           std::to_string(slot * kSlot / sizeof(T)) + "]";
+  }
+
+  template <typename T>
+  static constexpr const char *JSTypeName() {
+    if constexpr (std::is_same_v<T, bool>) {
+      return "boolean";
+    } else if constexpr (sizeof(T) == 8 && std::is_integral_v<T>) {
+      return "bigint";
+    } else {
+      return "number";
+    }
+  }
+
+  // anything else is converted, or rejected, by the checked function
+  template <typename... Ts, size_t... Is>
+  static std::string Check(std::index_sequence<Is...>) {
+    std::string source = "false";
+    ((source += std::string(" || typeof a") + std::to_string(Is) +
+                " !== '" + JSTypeName<Ts>() + "'"),
+     ...);
+    return source;
+  }
+
+  template <typename... Ts, size_t... Is>
+  static std::string Store(std::index_sequence<Is...>) {
+    std::string source;
+    ((source += Slot<Ts>(Is) + " = " +
+                (std::is_same_v<Ts, bool> ? "a" + std::to_string(Is) + " ? 1 : 0"
+                                          : "a" + std::to_string(Is)) +
+                "; "),
+     ...);
+    return source;
+  }
+
+  template <typename... Ts>
+  static std::string Source(std::tuple<Ts...> *) {
+    std::string params;
+    for (size_t i = 0; i < kArgs; i++) {
+      params += (i == 0 ? "a" : ", a") + std::to_string(i);
+    }
+    std::string ret;
+    if constexpr (std::is_same_v<Ret, bool>) {
+      ret = "return " + Slot<Ret>(kArgs) + " !== 0;";
+    } else if constexpr (!std::is_void_v<Ret>) {
+      ret = "return " + Slot<Ret>(kArgs) + ";";
+    }
+    return "(function (native, checked, buffer, name) {"
+           "  const i8 = new Int8Array(buffer), u8 = new Uint8Array(buffer);"
+           "  const i16 = new Int16Array(buffer), u16 = new Uint16Array(buffer);"
+           "  const i32 = new Int32Array(buffer), u32 = new Uint32Array(buffer);"
+           "  const f32 = new Float32Array(buffer), f64 = new Float64Array(buffer);"
+           "  const i64 = new BigInt64Array(buffer);"
+           "  const u64 = new BigUint64Array(buffer);"
+           "  const fn = function (" +
+           params + ") {" + "if (" +
+           Check<Ts...>(std::index_sequence_for<Ts...>{}) +
+           ") { return checked.apply(this, arguments); } " +
+           Store<Ts...>(std::index_sequence_for<Ts...>{}) + "native(); " +
+           ret +
+           "};"
+           "  Object.defineProperty(fn, 'name', { value: name });"
+           "  return fn;"
+           "})";
+  }
+
+  template <typename T>
+  static T Load(const char *slots, size_t slot) {
+    T value;
+    std::memcpy(&value, slots + slot * kSlot, sizeof(T));
+    return value;
+  }
+
+  // arguments are read before the call, which may call the stub again
+  template <typename... Ts, size_t... Is>
+  static void Call(char *slots, std::tuple<Ts...> *,
+                   std::index_sequence<Is...>) {
+    if constexpr (std::is_void_v<Ret>) {
+      fn(Load<Ts>(slots, Is)...);
+    } else {
+      Ret ret = fn(Load<Ts>(slots, Is)...);
+      std::memcpy(slots + kArgs * kSlot, &ret, sizeof(Ret));
+    }
+  }
+
+  static napi_value Callback(napi_env env, napi_callback_info info) {
+    void *data = nullptr;
+    napi_get_cb_info(env, info, nullptr, nullptr, nullptr, &data);
+    char *slots = static_cast<char *>(data);
+#ifdef NAPI_CPP_EXCEPTIONS
+    try {
+      Call(slots, static_cast<Args *>(nullptr),
+           std::make_index_sequence<kArgs>{});
+    } catch (const RangeError &e) {
+      RangeError::JSError::New(env, e.Message()).ThrowAsJavaScriptException();
+    } catch (const TypeError &e) {
+      TypeError::JSError::New(env, e.Message()).ThrowAsJavaScriptException();
+    } catch (const Error &e) {
+      Error::JSError::New(env, e.Message()).ThrowAsJavaScriptException();
+    } catch (const Napi::Error &e) {
+      e.ThrowAsJavaScriptException();
+    }
+#else
+    Call(slots, static_cast<Args *>(nullptr),
+         std::make_index_sequence<kArgs>{});
+#endif
+    return nullptr;
+  }
+};
 
 }  // namespace details
 
@@ -918,14 +3353,20 @@ struct ValueTransformer<
     std::enable_if_t<
         std::is_function_v<std::remove_pointer_t<Callable>> ||
         std::is_member_function_pointer_v<decltype(&Callable::operator())>>> {
+  static constexpr JSType kJSType = JSType::kFunction;
+
   static std::optional<Callable> FromJS(Napi::Value value) {
+    return FromJS(value, details::TypeOf(value, false));
+  }
+
+  static std::optional<Callable> FromJS(Napi::Value value, JSType type) {
     static_assert(details::is_std_function<Callable>::value,
                   "arguments fn can only be std::function<void(Args...)>");
-    if (!value.IsFunction()) {
+    if (type != JSType::kFunction) {
       return {};
     }
-    Napi::Function fun = value.As<Napi::Function>();
-    return details::TSFNContainer<Callable>::Create(fun);
+    return details::TSFNContainer<Callable>::Create(
+        value.As<Napi::Function>());
   }
 
   static Napi::Value ToJS(Napi::Env env, Callable v) {
@@ -1033,6 +3474,33 @@ inline const std::string &Error::Message() const NAPI_NOEXCEPT {
   return _message;
 }
 
+namespace details {
+// reserved by a dynamic initializer when the library is loaded, slot + 1 so
+// that a static initializer running earlier reads 0
+template <typename Literal>
+struct InternedSlot {
+  static inline const size_t value = EnvState::ReserveStrings(1) + 1;
+};
+}  // namespace details
+
+inline InternedString::InternedString(std::string_view str, size_t slot)
+    NAPI_NOEXCEPT : _str(str), _slot(slot) {}
+
+template <typename Literal>
+inline InternedString InternedString::Of(Literal literal) NAPI_NOEXCEPT {
+  static_assert(std::is_empty_v<Literal>,
+                "slots are shared by the type of the literal");
+  size_t slot = details::InternedSlot<Literal>::value;
+  return InternedString(literal(),
+                        slot != 0 ? slot - 1 : details::EnvState::kNoSlot);
+}
+
+inline std::string_view InternedString::str() const NAPI_NOEXCEPT {
+  return _str;
+}
+
+inline size_t InternedString::slot() const NAPI_NOEXCEPT { return _slot; }
+
 #ifdef NAPI_CPP_EXCEPTIONS
 
 inline const char *Error::what() const NAPI_NOEXCEPT {
@@ -1045,12 +3513,22 @@ namespace details {
 class ScriptWrappable : public Napi::ObjectWrap<ScriptWrappable> {
  private:
   std::unique_ptr<Class> _wrapped;
+  size_t _external_memory = 0;
 
-  template <auto fn>
-  auto InstanceMethodCallback(const Napi::CallbackInfo &);
+  template <typename T, bool is_method>
+  static T *UnwrapReceiver(const Napi::CallbackInfo &info);
 
-  template <auto fn>
-  void InstanceSetterCallback(const Napi::CallbackInfo &, const Napi::Value &);
+  template <typename Callback>
+  static napi_value WrapNativeCallback(napi_env env, napi_callback_info cb_info,
+                                       Callback cb);
+
+  template <typename T, auto fn, bool is_method>
+  static napi_value InstanceCallback(napi_env env, napi_callback_info cb_info);
+
+  static PropertyDescriptor InstanceDescriptor(
+      const char *utf8name, napi_value name, napi_callback method,
+      napi_callback getter, napi_callback setter,
+      napi_property_attributes attributes, void *data);
 
   template <auto fn>
   static auto StaticMethodCallback(const Napi::CallbackInfo &);
@@ -1063,38 +3541,39 @@ class ScriptWrappable : public Napi::ObjectWrap<ScriptWrappable> {
   static const napi_type_tag *type_tag();
 
   ScriptWrappable(const Napi::CallbackInfo &info);
+  ~ScriptWrappable() override;
 
   Class &wrapped() const;
 
   template <typename T, typename... Args>
   static std::unique_ptr<Class> ConstructCallback(const Napi::CallbackInfo &);
 
-  template <auto fn>
+  template <typename T, auto fn>
   static PropertyDescriptor InstanceMethod(
       const char *name, napi_property_attributes attributes = napi_default,
       void *data = nullptr);
 
-  template <auto fn>
+  template <typename T, auto fn>
   static PropertyDescriptor InstanceMethod(
       Napi::Symbol name, napi_property_attributes attributes = napi_default,
       void *data = nullptr);
 
-  template <auto getter>
+  template <typename T, auto getter>
   static PropertyDescriptor InstanceAccessor(
       const char *utf8name, napi_property_attributes attributes = napi_default,
       void *data = nullptr);
 
-  template <auto getter, auto setter>
+  template <typename T, auto getter, auto setter>
   static PropertyDescriptor InstanceAccessor(
       const char *utf8name, napi_property_attributes attributes = napi_default,
       void *data = nullptr);
 
-  template <auto getter>
+  template <typename T, auto getter>
   static PropertyDescriptor InstanceAccessor(
       Napi::Symbol name, napi_property_attributes attributes = napi_default,
       void *data = nullptr);
 
-  template <auto getter, auto setter>
+  template <typename T, auto getter, auto setter>
   static PropertyDescriptor InstanceAccessor(
       Napi::Symbol name, napi_property_attributes attributes = napi_default,
       void *data = nullptr);
@@ -1135,6 +3614,12 @@ inline ScriptWrappable::ScriptWrappable(const Napi::CallbackInfo &info)
   napi_type_tag_object(info.Env(), info.This(), type_tag());
 
   ClassMetaInfo *meta_info = reinterpret_cast<ClassMetaInfo *>(info.Data());
+  // subclasses are built by their base class, see
+  // Registration::ConstructSubclass
+  if (EnvState::constructing != nullptr) {
+    meta_info = EnvState::constructing;
+    EnvState::constructing = nullptr;
+  }
 
   if (info[0].IsExternal() &&
       info[0].As<Napi::External<napi_type_tag>>().Data() == type_tag()) {
@@ -1154,79 +3639,169 @@ inline ScriptWrappable::ScriptWrappable(const Napi::CallbackInfo &info)
   if (_wrapped) {
     // t_ctor may return nullptr if arg type mismatches (C++ exception disabled)
     _wrapped->_meta_info = meta_info;
+
+    for (ClassMetaInfo *it = meta_info; it != nullptr; it = it->parent) {
+      if (it->external_memory != nullptr) {
+        _external_memory = it->external_memory(*_wrapped);
+        AdjustExternalMemory(info.Env(),
+                             static_cast<int64_t>(_external_memory));
+        break;
+      }
+    }
   }
 }
 
+inline ScriptWrappable::~ScriptWrappable() {
+  AdjustExternalMemory(Env(), -static_cast<int64_t>(_external_memory));
+}
+
 inline Class &ScriptWrappable::wrapped() const { return *_wrapped; }
 
 template <typename T, typename... Args>
 inline std::unique_ptr<Class> ScriptWrappable::ConstructCallback(
     const Napi::CallbackInfo &info) {
   return details::Invoker::Call(
-      info, [](Args... args) -> std::unique_ptr<Class> {
-        return std::unique_ptr<Class>(new T(std::move(args)...));
+      info, [](Args &&...args) -> std::unique_ptr<Class> {
+        return std::unique_ptr<Class>(new T(std::forward<Args>(args)...));
       });
 }
 
-template <auto fn>
-inline auto ScriptWrappable::InstanceMethodCallback(
-    const Napi::CallbackInfo &info) {
-  using T = typename get_class_of_member_function<decltype(fn)>::type;
-  return details::Invoker::CallJS(
-      info,
-      details::Invoker::InstanceCall(static_cast<T *>(_wrapped.get()), fn));
+template <typename T, bool is_method>
+inline T *ScriptWrappable::UnwrapReceiver(const Napi::CallbackInfo &info) {
+  const ClassMetaInfo *meta_info = &ClassRegistration<T>::Instance();
+  // V8 has checked the receiver against the signature of a base class
+  bool checked = is_method && meta_info->parent == nullptr;
+
+  void *unwrapped = nullptr;
+  bool check_tag = checked;
+  if (napi_unwrap(info.Env(), info.This(), &unwrapped) != napi_ok ||
+      (!checked &&
+       (napi_check_object_type_tag(info.Env(), info.This(), type_tag(),
+                                   &check_tag) != napi_ok ||
+        !check_tag))) {
+    return nullptr;
+  }
+  Class *wrapped = static_cast<ScriptWrappable *>(
+                       static_cast<ObjectWrap<ScriptWrappable> *>(unwrapped))
+                       ->_wrapped.get();
+  if (wrapped == nullptr) {
+    return nullptr;
+  }
+
+  if (checked) {
+    return static_cast<T *>(wrapped);
+  }
+  for (const ClassMetaInfo *it = wrapped->meta_info(); it != nullptr;
+       it = it->parent) {
+    if (it == meta_info) {
+      return static_cast<T *>(wrapped);
+    }
+  }
+  return nullptr;
 }
 
-template <auto fn>
-inline void ScriptWrappable::InstanceSetterCallback(
-    const Napi::CallbackInfo &info, const Napi::Value &) {
-  using T = typename get_class_of_member_function<decltype(fn)>::type;
-  details::Invoker::CallJS(info, details::Invoker::InstanceCall(
-                                     static_cast<T *>(_wrapped.get()), fn));
+template <typename Callback>
+inline napi_value ScriptWrappable::WrapNativeCallback(
+    napi_env env, napi_callback_info cb_info, Callback cb) {
+#ifdef NAPI_CPP_EXCEPTIONS
+  try {
+    Napi::CallbackInfo info(env, cb_info);
+    return cb(info);
+  } catch (const Napi::Error &e) {
+    e.ThrowAsJavaScriptException();
+    return nullptr;
+  }
+#else
+  Napi::CallbackInfo info(env, cb_info);
+  return cb(info);
+#endif
 }
 
-template <auto fn>
+template <typename T, auto fn, bool is_method>
+inline napi_value ScriptWrappable::InstanceCallback(
+    napi_env env, napi_callback_info cb_info) {
+  return WrapNativeCallback(
+      env, cb_info, [](const Napi::CallbackInfo &info) -> napi_value {
+        T *receiver = UnwrapReceiver<T, is_method>(info);
+        if (receiver == nullptr) {
+          NAPI_THROW(Napi::TypeError::New(info.Env(), "Illegal invocation"),
+                     nullptr);
+        }
+
+        using C = typename get_class_of_member_function<decltype(fn)>::type;
+        C *instance = static_cast<C *>(receiver);
+        auto call = details::Invoker::InstanceCall<fn>(instance);
+        if constexpr (std::is_void_v<decltype(details::Invoker::CallJS(
+                          info, call))>) {
+          details::Invoker::CallJS(info, call);
+          return nullptr;
+        } else {
+          return details::Invoker::CallJS(info, call);
+        }
+      });
+}
+
+inline ScriptWrappable::PropertyDescriptor ScriptWrappable::InstanceDescriptor(
+    const char *utf8name, napi_value name, napi_callback method,
+    napi_callback getter, napi_callback setter,
+    napi_property_attributes attributes, void *data) {
+  napi_property_descriptor desc = napi_property_descriptor();
+  desc.utf8name = utf8name;
+  desc.name = name;
+  desc.method = method;
+  desc.getter = getter;
+  desc.setter = setter;
+  desc.attributes = attributes;
+  desc.data = data;
+  return desc;
+}
+
+template <typename T, auto fn>
 inline ScriptWrappable::PropertyDescriptor ScriptWrappable::InstanceMethod(
     const char *name, napi_property_attributes attributes, void *data) {
-  return ObjectWrap<ScriptWrappable>::InstanceMethod<
-      &ScriptWrappable::InstanceMethodCallback<fn>>(name, attributes, data);
+  return InstanceDescriptor(name, nullptr, &InstanceCallback<T, fn, true>,
+                            nullptr, nullptr, attributes, data);
 }
 
-template <auto getter>
+template <typename T, auto getter>
 inline ScriptWrappable::PropertyDescriptor ScriptWrappable::InstanceAccessor(
     const char *name, napi_property_attributes attributes, void *data) {
-  return ObjectWrap<ScriptWrappable>::InstanceAccessor<
-      &ScriptWrappable::InstanceMethodCallback<getter>>(name, attributes, data);
+  return InstanceDescriptor(name, nullptr, nullptr,
+                            &InstanceCallback<T, getter, false>, nullptr,
+                            attributes, data);
 }
 
-template <auto getter, auto setter>
+template <typename T, auto getter, auto setter>
 inline ScriptWrappable::PropertyDescriptor ScriptWrappable::InstanceAccessor(
     const char *name, napi_property_attributes attributes, void *data) {
-  return ObjectWrap<ScriptWrappable>::InstanceAccessor<
-      &ScriptWrappable::InstanceMethodCallback<getter>,
-      &ScriptWrappable::InstanceSetterCallback<setter>>(name, attributes, data);
+  return InstanceDescriptor(name, nullptr, nullptr,
+                            &InstanceCallback<T, getter, false>,
+                            &InstanceCallback<T, setter, false>, attributes,
+                            data);
 }
 
-template <auto fn>
+template <typename T, auto fn>
 inline ScriptWrappable::PropertyDescriptor ScriptWrappable::InstanceMethod(
     Napi::Symbol name, napi_property_attributes attributes, void *data) {
-  return ObjectWrap<ScriptWrappable>::InstanceMethod<
-      &ScriptWrappable::InstanceMethodCallback<fn>>(name, attributes, data);
+  return InstanceDescriptor(nullptr, name, &InstanceCallback<T, fn, true>,
+                            nullptr, nullptr, attributes, data);
 }
 
-template <auto getter>
+template <typename T, auto getter>
 inline ScriptWrappable::PropertyDescriptor ScriptWrappable::InstanceAccessor(
     Napi::Symbol name, napi_property_attributes attributes, void *data) {
-  return ObjectWrap<ScriptWrappable>::InstanceAccessor<
-      &ScriptWrappable::InstanceMethodCallback<getter>>(name, attributes, data);
+  return InstanceDescriptor(nullptr, name, nullptr,
+                            &InstanceCallback<T, getter, false>, nullptr,
+                            attributes, data);
 }
 
-template <auto getter, auto setter>
+template <typename T, auto getter, auto setter>
 inline ScriptWrappable::PropertyDescriptor ScriptWrappable::InstanceAccessor(
     Napi::Symbol name, napi_property_attributes attributes, void *data) {
-  return ObjectWrap<ScriptWrappable>::InstanceAccessor<
-      &ScriptWrappable::InstanceMethodCallback<getter>,
-      &ScriptWrappable::InstanceSetterCallback<setter>>(name, attributes, data);
+  return InstanceDescriptor(nullptr, name, nullptr,
+                            &InstanceCallback<T, getter, false>,
+                            &InstanceCallback<T, setter, false>, attributes,
+                            data);
 }
 
 template <auto fn>
@@ -1291,9 +3866,48 @@ inline const napi_type_tag *ScriptWrappable::type_tag() {
   return &tag;
 }
 
+// a NAAH_REGISTRATION body, linked into a list when the library is loaded
+// and only run when the addon is initialized for the first time
+class RegistrationHook {
+ public:
+  using Fn = void (*)();
+
+  explicit RegistrationHook(Fn fn) : _fn(fn), _next(nullptr), _done(false) {
+    *_tail = this;
+    _tail = &_next;
+  }
+
+  static void RunPending() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (RegistrationHook *it = _head; it != nullptr; it = it->_next) {
+      if (!it->_done) {
+        it->_done = true;
+        it->_fn();
+      }
+    }
+  }
+
+ private:
+  Fn _fn;
+  RegistrationHook *_next;
+  bool _done;
+
+  // constant initialized, so hooks can be linked from any static initializer
+  static inline RegistrationHook *_head = nullptr;
+  static inline RegistrationHook **_tail = &_head;
+  static inline std::mutex _mutex;
+};
+
+// an export, created by init_cb in each env. payload is what it converts
+// or calls, kept for the process since registration bodies run once
 struct RegistrationEntry {
+  using InitFn = Napi::Value (*)(Napi::Env env,
+                                 const RegistrationEntry &entry);
+
   const char *name;
-  std::function<Napi::Value(Napi::Env, const char *)> init_cb;
+  InitFn init_cb;
+  void *data;
+  const void *payload;
 
   static std::vector<RegistrationEntry> &Entries() {
     static std::vector<RegistrationEntry> entries;
@@ -1306,19 +3920,39 @@ struct ClassRegistrationEntry {
     static std::vector<ClassMetaInfo *> entries;
     return entries;
   }
+
+  static bool &Lazy() {
+    static bool lazy = false;
+    return lazy;
+  }
 };
 
+// the topmost registered ancestor, which is defined by napi_define_class
+inline ClassMetaInfo *BaseClassOf(ClassMetaInfo *meta_info) {
+  while (meta_info->parent != nullptr &&
+         meta_info->parent->id != ClassMetaInfo::kInvalidId) {
+    meta_info = meta_info->parent;
+  }
+  return meta_info;
+}
+
 template <typename T>
 class ClassRegistration {
  public:
   static ClassMetaInfo &Instance() {
-    static ClassMetaInfo instance{nullptr, nullptr, nullptr, {}};
+    static ClassMetaInfo instance{
+        nullptr, nullptr, nullptr, {}, ClassMetaInfo::kInvalidId, nullptr};
     return instance;
   }
 
   static void DefineClass() {
     ClassMetaInfo &instance = Instance();
-    ClassRegistrationEntry::Entries().push_back(&instance);
+    if (instance.id != ClassMetaInfo::kInvalidId) {
+      return;
+    }
+    auto &entries = ClassRegistrationEntry::Entries();
+    instance.id = entries.size();
+    entries.push_back(&instance);
   }
 
   static void AddPropertyDescriptor(
@@ -1330,6 +3964,10 @@ class ClassRegistration {
 
   static void SetConstructor(Class::ConstructFn fn) { Instance().ctor = fn; }
 
+  static void SetExternalMemory(Class::ExternalMemoryFn fn) {
+    Instance().external_memory = fn;
+  }
+
   template <typename P>
   static void SetParentClass() {
     static_assert(std::is_base_of_v<Class, P>, "must inherit class");
@@ -1342,15 +3980,22 @@ class ClassRegistration {
 template <typename T>
 struct ValueTransformer<T *, std::enable_if_t<std::is_base_of_v<Class, T>>> {
  public:
+  static constexpr JSType kJSType = JSType::kObject;
+
   static std::optional<T *> FromJS(Napi::Value value) {
-    if (!value.IsObject()) {
+    // napi_check_object_type_tag runs ToObject, which throws for undefined
+    // and null
+    napi_valuetype type = napi_undefined;
+    if (napi_typeof(value.Env(), value, &type) != napi_ok ||
+        type != napi_object) {
       return {};
     }
     Napi::Object obj = value.As<Napi::Object>();
     bool check_tag = false;
-    napi_check_object_type_tag(
-        value.Env(), obj, details::ScriptWrappable::type_tag(), &check_tag);
-    if (!check_tag) {
+    if (napi_check_object_type_tag(value.Env(), obj,
+                                   details::ScriptWrappable::type_tag(),
+                                   &check_tag) != napi_ok ||
+        !check_tag) {
       return {};
     }
     Class &instance = details::ScriptWrappable::Unwrap(obj)->wrapped();
@@ -1375,8 +4020,15 @@ template <typename T>
 struct ValueTransformer<T, std::enable_if_t<std::is_base_of_v<Class, T>>> {
  public:
   static Napi::Value ToJS(Napi::Env env, T t) {
-    Registration *reg = env.GetInstanceData<Registration>();
-    Napi::Function clazz = reg->FindClass<T>();
+    Napi::Function clazz;
+    if (details::ClassCache *cache = details::ClassCache::Of(env)) {
+      clazz = cache->Get(&details::ClassRegistration<T>::Instance());
+    }
+    if (clazz.IsEmpty()) {
+      if (Registration *reg = env.GetInstanceData<Registration>()) {
+        clazz = reg->FindClass<T>();
+      }
+    }
     if (clazz.IsEmpty()) {
       return env.Undefined();  // prevent crash
     }
@@ -1392,97 +4044,406 @@ struct ValueTransformer<T, std::enable_if_t<std::is_base_of_v<Class, T>>> {
 };
 
 inline Registration::Registration(Napi::Env env, Napi::Object exports) {
-  for (auto &it : details::RegistrationEntry::Entries()) {
-    exports.Set(it.name, it.init_cb(env, it.name));
+  details::RegistrationHook::RunPending();
+  state_.classes.resize(details::ClassRegistrationEntry::Entries().size());
+  state_.exports = Napi::Persistent(exports);
+
+  bool lazy_classes = details::ClassRegistrationEntry::Lazy();
+
+  // exports are defined in one batch, lazy classes as getters which define
+  // the class on first access and then replace themselves with it
+  std::vector<details::RegistrationEntry> &entries =
+      details::RegistrationEntry::Entries();
+  std::vector<napi_property_descriptor> descriptors;
+  descriptors.reserve(entries.size() +
+                      (lazy_classes ? state_.classes.size() : 0));
+  for (details::RegistrationEntry &entry : entries) {
+    napi_property_descriptor descriptor = napi_property_descriptor();
+    descriptor.utf8name = entry.name;
+    descriptor.value = entry.init_cb(env, entry);
+    descriptor.attributes = static_cast<napi_property_attributes>(
+        napi_writable | napi_enumerable | napi_configurable);
+    descriptors.push_back(descriptor);
+  }
+  if (lazy_classes) {
+    for (ClassMetaInfo *it : details::ClassRegistrationEntry::Entries()) {
+      napi_property_descriptor descriptor = napi_property_descriptor();
+      descriptor.utf8name = it->name;
+      descriptor.getter = LazyClassGetter;
+      descriptor.attributes = static_cast<napi_property_attributes>(
+          napi_enumerable | napi_configurable);
+      descriptor.data = it;
+      descriptors.push_back(descriptor);
+    }
+  }
+  napi_status status = napi_define_properties(env, exports, descriptors.size(),
+                                              descriptors.data());
+  NAPI_THROW_IF_FAILED_VOID(env, status);
+
+  if (!lazy_classes) {
+    for (ClassMetaInfo *it : details::ClassRegistrationEntry::Entries()) {
+      DefineClass(env, it);
+    }
+  }
+}
+
+inline details::EnvState *details::EnvState::Of(Napi::Env env) {
+  Registration *reg = env.GetInstanceData<Registration>();
+  return reg != nullptr ? &reg->state_ : nullptr;
+}
+
+inline CallStats::CallStats(size_t argc) NAPI_NOEXCEPT
+    : _argc(argc),
+      _start(std::chrono::steady_clock::now()),
+      _previous(_current) {
+  _current = this;
+}
+
+inline CallStats::~CallStats() { _current = _previous; }
+
+inline CallStats *CallStats::Current() NAPI_NOEXCEPT { return _current; }
+
+inline size_t CallStats::argc() const NAPI_NOEXCEPT { return _argc; }
+
+inline std::chrono::nanoseconds CallStats::Elapsed() const NAPI_NOEXCEPT {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - _start);
+}
+
+inline std::chrono::nanoseconds CallStats::conversion() const NAPI_NOEXCEPT {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(_conversion);
+}
+
+inline StopToken::StopToken(std::shared_ptr<const std::atomic<bool>> stopped)
+    NAPI_NOEXCEPT : _stopped(std::move(stopped)) {}
+
+inline bool StopToken::stop_requested() const NAPI_NOEXCEPT {
+  return _stopped != nullptr && _stopped->load(std::memory_order_relaxed);
+}
+
+inline StopToken details::ContextOf<StopToken>::Get(Napi::Env env) {
+  EnvState *state = EnvState::Of(env);
+  return state != nullptr ? StopToken(state->stopped) : StopToken();
+}
+
+inline size_t details::EnvState::ReserveStrings(size_t count) {
+  static std::atomic<size_t> next{0};
+  return next.fetch_add(count);
+}
+
+inline Napi::Value details::EnvState::String(Napi::Env env, size_t slot,
+                                             std::string_view str) {
+  EnvState *state = slot != kNoSlot ? Of(env) : nullptr;
+  if (state == nullptr || !state->string_refs) {
+    return Napi::String::New(env, str.data(), str.size());
+  }
+  if (slot < state->strings.size() && !state->strings[slot].IsEmpty()) {
+    return state->strings[slot].Value();
   }
-  for (auto &it : details::ClassRegistrationEntry::Entries()) {
-    DefineClass(env, it, exports);
+  Napi::String js_str = Napi::String::New(env, str.data(), str.size());
+  napi_ref ref;
+  if (napi_create_reference(env, js_str, 1, &ref) != napi_ok) {
+    // only objects, functions and symbols before Node-API 10
+    state->string_refs = false;
+    return js_str;
   }
+  if (slot >= state->strings.size()) {
+    state->strings.resize(slot + 1);
+  }
+  state->strings[slot] = Napi::Reference<Napi::Value>(env, ref);
+  return js_str;
+}
+
+inline Napi::Function details::EnvState::SharedBufferHelper(Napi::Env env,
+                                                           uint32_t index) {
+  EnvState *state = Of(env);
+  if (state != nullptr && !state->shared_buffer_helpers.IsEmpty()) {
+    return state->shared_buffer_helpers.Value()
+        .Get(index)
+        .As<Napi::Function>();
+  }
+  // indexed by SharedBufferHelperIndex
+  Napi::Value helpers = env.RunScript(
+      "[function view(buffer, size) {"
+      "  if (buffer === undefined) buffer = new SharedArrayBuffer(size);"
+      "  else if (!(buffer instanceof SharedArrayBuffer)) return undefined;"
+      "  return new Uint8Array(buffer);"
+      "}, function notify(buffer) {"
+      "  const view = new Int32Array(buffer, 0, buffer.byteLength >> 2);"
+      "  for (let i = 1; i < arguments.length; i++) {"
+      "    Atomics.notify(view, arguments[i]);"
+      "  }"
+      "}]");
+  if (helpers.IsEmpty()) {
+    return Napi::Function();
+  }
+  Napi::Object obj = helpers.As<Napi::Object>();
+  if (state != nullptr) {
+    state->shared_buffer_helpers = Napi::Persistent(obj);
+  }
+  return obj.Get(index).As<Napi::Function>();
 }
 
 template <typename T>
 inline Napi::Function Registration::FindClass() {
-  ClassMetaInfo *key = &details::ClassRegistration<T>::Instance();
-  auto it = classes_.find(key);
-  return it == classes_.end() ? Napi::Function() : it->second.Value();
+  return ClassOf(&details::ClassRegistration<T>::Instance());
+}
+
+inline Napi::Function Registration::ClassOf(ClassMetaInfo *meta_info) {
+  if (meta_info->id >= state_.classes.size()) {
+    return Napi::Function();
+  }
+  if (state_.classes[meta_info->id].IsEmpty()) {
+    DefineClass(state_.exports.Env(), meta_info);
+  }
+  return state_.classes[meta_info->id].Value();
+}
+
+inline napi_value Registration::LazyClassGetter(napi_env env,
+                                                napi_callback_info cb_info) {
+#ifdef NAPI_CPP_EXCEPTIONS
+  try {
+    Napi::CallbackInfo info(env, cb_info);
+    Registration *reg = info.Env().GetInstanceData<Registration>();
+    return reg->ClassOf(static_cast<ClassMetaInfo *>(info.Data()));
+  } catch (const Napi::Error &e) {
+    e.ThrowAsJavaScriptException();
+    return nullptr;
+  }
+#else
+  Napi::CallbackInfo info(env, cb_info);
+  Registration *reg = info.Env().GetInstanceData<Registration>();
+  return reg->ClassOf(static_cast<ClassMetaInfo *>(info.Data()));
+#endif
 }
 
-inline void Registration::DefineClass(Napi::Env env, ClassMetaInfo *meta_info,
-                                      Napi::Object exports) {
-  auto it = classes_.find(meta_info);
-  if (it != classes_.end()) {
+inline void Registration::Export(Napi::Env env, const char *name,
+                                 napi_value value) {
+  // defined rather than assigned, to replace the lazy getter
+  napi_property_descriptor descriptor = napi_property_descriptor();
+  descriptor.utf8name = name;
+  descriptor.value = value;
+  descriptor.attributes = static_cast<napi_property_attributes>(
+      napi_writable | napi_enumerable | napi_configurable);
+  napi_status status =
+      napi_define_properties(env, state_.exports.Value(), 1, &descriptor);
+  NAPI_THROW_IF_FAILED_VOID(env, status);
+}
+
+inline void Registration::DefineClass(Napi::Env env,
+                                      ClassMetaInfo *meta_info) {
+  if (meta_info->id >= state_.classes.size() ||
+      !state_.classes[meta_info->id].IsEmpty()) {
     return;
   }
 
-  std::vector<details::ScriptWrappable::PropertyDescriptor> descriptors(
-      reinterpret_cast<details::ScriptWrappable::PropertyDescriptor *>(
-          meta_info->descriptors.data()),
-      reinterpret_cast<details::ScriptWrappable::PropertyDescriptor *>(
-          meta_info->descriptors.data()) +
-          meta_info->descriptors.size());
+  ClassMetaInfo *parent = meta_info->parent;
+  if (parent != nullptr) {
+    DefineClass(env, parent);
+  }
 
-  if (meta_info->parent) {
-    ClassMetaInfo *parent = meta_info->parent;
-    DefineClass(env, parent, exports);
-    while (parent != nullptr) {
-      descriptors.insert(
-          descriptors.end(),
-          reinterpret_cast<details::ScriptWrappable::PropertyDescriptor *>(
-              parent->descriptors.data()),
-          reinterpret_cast<details::ScriptWrappable::PropertyDescriptor *>(
-              parent->descriptors.data()) +
-              parent->descriptors.size());
-      parent = parent->parent;
+  Napi::Function clazz;
+  if (parent != nullptr && parent->id < state_.classes.size()) {
+    clazz = DefineSubclass(env, meta_info);
+    if (clazz.IsEmpty()) {
+      return;
     }
+  } else {
+    std::vector<details::ScriptWrappable::PropertyDescriptor> descriptors(
+        meta_info->descriptors.begin(), meta_info->descriptors.end());
+    clazz = details::ScriptWrappable::DefineClass(
+        env, meta_info->name, descriptors, reinterpret_cast<void *>(meta_info));
   }
 
-  Napi::Function clazz = details::ScriptWrappable::DefineClass(
-      env, meta_info->name, descriptors, reinterpret_cast<void *>(meta_info));
+  state_.classes[meta_info->id] = Napi::Persistent(clazz);
+  Export(env, meta_info->name, clazz);
+}
+
+inline Napi::Function Registration::DefineSubclass(Napi::Env env,
+                                                   ClassMetaInfo *meta_info) {
+  // a subclass only carries its own members. Its instances are built by the
+  // base class, so methods inherited from it keep their signature checks,
+  // which is why its own methods are plain functions checking receivers by
+  // their type tag instead.
+  std::vector<napi_property_descriptor> class_descriptors;
+  std::vector<napi_property_descriptor> methods;
+  for (const napi_property_descriptor &descriptor : meta_info->descriptors) {
+    if (descriptor.method != nullptr && !(descriptor.attributes & napi_static)) {
+      // napi_define_properties leaves methods unnamed
+      napi_property_descriptor method = descriptor;
+      napi_status status = napi_create_function(
+          env, descriptor.utf8name, NAPI_AUTO_LENGTH, descriptor.method,
+          descriptor.data, &method.value);
+      NAPI_THROW_IF_FAILED(env, status, Napi::Function());
+      method.method = nullptr;
+      method.data = nullptr;
+      methods.push_back(method);
+    } else {
+      class_descriptors.push_back(descriptor);
+    }
+  }
 
-  if (meta_info->parent) {
-    Napi::Function parent_clazz =
-        classes_.find(meta_info->parent)->second.Value();
+  napi_value clazz;
+  napi_status status = napi_define_class(
+      env, meta_info->name, NAPI_AUTO_LENGTH, ConstructSubclass, meta_info,
+      class_descriptors.size(), class_descriptors.data(), &clazz);
+  NAPI_THROW_IF_FAILED(env, status, Napi::Function());
+
+  napi_value prototype;
+  status = napi_get_named_property(env, clazz, "prototype", &prototype);
+  NAPI_THROW_IF_FAILED(env, status, Napi::Function());
+  status = napi_define_properties(env, prototype, methods.size(),
+                                  methods.data());
+  NAPI_THROW_IF_FAILED(env, status, Napi::Function());
+
+  // N-API has no `extends`, link both prototype chains like it does
+  Napi::Function parent = state_.classes[meta_info->parent->id].Value();
+  Napi::Function set_prototype_of = env.Global()
+                                        .Get("Object")
+                                        .As<Napi::Object>()
+                                        .Get("setPrototypeOf")
+                                        .As<Napi::Function>();
+  set_prototype_of.Call({prototype, parent.Get("prototype")});
+  set_prototype_of.Call({clazz, parent});
+  if (env.IsExceptionPending()) {
+    return Napi::Function();
+  }
+  return Napi::Function(env, clazz);
+}
 
-    Napi::Object global = env.Global();
-    Napi::Object Object = global.Get("Object").As<Napi::Object>();
-    Napi::Function setPrototypeOf =
-        Object.Get("setPrototypeOf").As<Napi::Function>();
+inline napi_value Registration::ConstructSubclass(napi_env env,
+                                                  napi_callback_info cb_info) {
+  auto construct = [](const Napi::CallbackInfo &info) -> napi_value {
+    Napi::Env env = info.Env();
+    Napi::Value new_target = info.NewTarget();
+    if (new_target.IsEmpty()) {
+      NAPI_THROW(Napi::TypeError::New(
+                     env, "Class constructors cannot be invoked without 'new'"),
+                 nullptr);
+    }
 
-    Napi::Value clazz_proto = clazz.Get("prototype");
-    Napi::Value parent_proto = parent_clazz.Get("prototype");
+    Registration *reg = env.GetInstanceData<Registration>();
+    details::EnvState &state = reg->state_;
+    ClassMetaInfo *meta_info = static_cast<ClassMetaInfo *>(info.Data());
+    if (state.reflect_construct.IsEmpty()) {
+      state.reflect_construct = Napi::Persistent(env.Global()
+                                                     .Get("Reflect")
+                                                     .As<Napi::Object>()
+                                                     .Get("construct")
+                                                     .As<Napi::Function>());
+    }
 
-    setPrototypeOf.Call({clazz_proto, parent_proto});
-    setPrototypeOf.Call({clazz, parent_clazz});
-  }
+    napi_value args;
+    napi_status status = napi_create_array_with_length(env, info.Length(), &args);
+    NAPI_THROW_IF_FAILED(env, status, nullptr);
+    for (size_t i = 0; i < info.Length(); ++i) {
+      status = napi_set_element(env, args, i, info[i]);
+      NAPI_THROW_IF_FAILED(env, status, nullptr);
+    }
 
-  classes_[meta_info] = Napi::Persistent(clazz);
-  exports[meta_info->name] = clazz;
+    // like `super(...args)`, read back by the ScriptWrappable constructor of
+    // the base class, which the engine calls right away
+    Napi::Function base =
+        state.classes[details::BaseClassOf(meta_info)->id].Value();
+    napi_value argv[] = {base, args, new_target};
+    napi_value instance;
+    details::EnvState::constructing = meta_info;
+    status = napi_call_function(env, env.Undefined(),
+                                state.reflect_construct.Value(), 3, argv,
+                                &instance);
+    details::EnvState::constructing = nullptr;
+    NAPI_THROW_IF_FAILED(env, status, nullptr);
+    return instance;
+  };
+#ifdef NAPI_CPP_EXCEPTIONS
+  try {
+    Napi::CallbackInfo info(env, cb_info);
+    return construct(info);
+  } catch (const Napi::Error &e) {
+    e.ThrowAsJavaScriptException();
+    return nullptr;
+  }
+#else
+  Napi::CallbackInfo info(env, cb_info);
+  return construct(info);
+#endif
 }
 
 template <typename T>
 inline void Registration::Value(const char *name, T val) {
-  details::RegistrationEntry::Entries().push_back(
-      {name, [val = std::move(val)](Napi::Env env, const char *) {
-         return ValueTransformer<T>::ToJS(env, std::move(val));
-       }});
+  using Entry = details::RegistrationEntry;
+  Entry::Entries().push_back(
+      {name,
+       [](Napi::Env env, const Entry &entry) -> Napi::Value {
+         return ValueTransformer<T>::ToJS(
+             env, *static_cast<const T *>(entry.payload));
+       },
+       nullptr, new T(std::move(val))});
 }
 
 template <auto fn>
 inline void Registration::Function(const char *name, void *data) {
-  details::RegistrationEntry::Entries().push_back(
-      {name, [data](Napi::Env env, const char *name) {
-         return details::Function::New<fn>(env, name, data);
-       }});
+  using Entry = details::RegistrationEntry;
+  Entry::Entries().push_back(
+      {name,
+       [](Napi::Env env, const Entry &entry) -> Napi::Value {
+         return details::Function::New<fn>(env, entry.name, entry.data);
+       },
+       data, nullptr});
 }
 
 template <typename Callable>
 inline void Registration::Function(const char *name, Callable callable,
                                    void *data) {
-  details::RegistrationEntry::Entries().push_back(
+  using Entry = details::RegistrationEntry;
+  using Closure = details::Closure<Callable>;
+  if constexpr (Closure::kStateless) {
+    // kept by its type
+    Closure::Stateless(&callable);
+    Entry::Entries().push_back(
+        {name,
+         [](Napi::Env env, const Entry &entry) -> Napi::Value {
+           return details::Function::New(env, Closure::Stateless(),
+                                         entry.name, entry.data);
+         },
+         data, nullptr});
+  } else {
+    Entry::Entries().push_back(
+        {name,
+         [](Napi::Env env, const Entry &entry) -> Napi::Value {
+           return details::Function::New(
+               env, *static_cast<const Callable *>(entry.payload), entry.name,
+               entry.data);
+         },
+         data, new Callable(std::move(callable))});
+  }
+}
+
+template <auto fn>
+inline void Registration::BatchFunction(const char *name, void *data) {
+  using Entry = details::RegistrationEntry;
+  Entry::Entries().push_back(
+      {name,
+       [](Napi::Env env, const Entry &entry) -> Napi::Value {
+         return Napi::Function::New<details::Invoker::BatchCallback<fn>>(
+             env, entry.name, entry.data);
+       },
+       data, nullptr});
+}
+
+template <auto fn>
+inline void Registration::FastFunction(const char *name) {
+  using Entry = details::RegistrationEntry;
+  Entry::Entries().push_back(
       {name,
-       [callable = std::move(callable), data](Napi::Env env, const char *name) {
-         return details::Function::New(env, callable, name, data);
-       }});
+       [](Napi::Env env, const Entry &entry) -> Napi::Value {
+         return details::FastFunction<fn>::New(env, entry.name);
+       },
+       nullptr, nullptr});
+}
+
+inline void Registration::LazyClasses() {
+  details::ClassRegistrationEntry::Lazy() = true;
 }
 
 inline Class::Class() : _meta_info(nullptr) {}
@@ -1517,12 +4478,22 @@ inline ClassRegistration<T> &ClassRegistration<T>::Inherits() {
   return *this;
 }
 
+template <typename T>
+template <auto T::*fn>
+inline ClassRegistration<T> &ClassRegistration<T>::ExternalMemory() {
+  details::ClassRegistration<T>::SetExternalMemory([](Class &c) -> size_t {
+    return (static_cast<T &>(c).*fn)();
+  });
+
+  return *this;
+}
+
 template <typename T>
 template <auto T::*fn>
 inline ClassRegistration<T> &ClassRegistration<T>::InstanceMethod(
     const char *name, napi_property_attributes attributes, void *data) {
   details::ClassRegistration<T>::AddPropertyDescriptor(
-      details::ScriptWrappable::InstanceMethod<fn>(name, attributes, data));
+      details::ScriptWrappable::InstanceMethod<T, fn>(name, attributes, data));
   return *this;
 }
 
@@ -1531,8 +4502,8 @@ template <auto T::*getter>
 inline ClassRegistration<T> &ClassRegistration<T>::InstanceAccessor(
     const char *name, napi_property_attributes attributes, void *data) {
   details::ClassRegistration<T>::AddPropertyDescriptor(
-      details::ScriptWrappable::InstanceAccessor<getter>(name, attributes,
-                                                         data));
+      details::ScriptWrappable::InstanceAccessor<T, getter>(name, attributes,
+                                                            data));
   return *this;
 }
 
@@ -1541,7 +4512,7 @@ template <auto T::*getter, auto T::*setter>
 inline ClassRegistration<T> &ClassRegistration<T>::InstanceAccessor(
     const char *name, napi_property_attributes attributes, void *data) {
   details::ClassRegistration<T>::AddPropertyDescriptor(
-      details::ScriptWrappable::InstanceAccessor<getter, setter>(
+      details::ScriptWrappable::InstanceAccessor<T, getter, setter>(
           name, attributes, data));
   return *this;
 }
@@ -1578,10 +4549,46 @@ namespace details {
 
 template <typename T>
 struct ObjectFieldEntry {
-  std::function<bool(Napi::Object, T &)> FromJS;
+  const char *name;
+  // converts the value of the field, read once by FromObject
+  std::function<bool(Napi::Value, T &)> FromJS;
   std::function<void(T &, Napi::Object)> ToJS;
+  // whether the JS type of the value fits the field, checked for all fields
+  // before any of them is converted
+  std::function<bool(Napi::Value)> Accepts;
 };
 
+// a member of T as laid out in a StructArray<T>
+struct StructField {
+  const char *name;
+  size_t offset;
+  // DataView accessor of the member, e.g. "Float32"
+  const char *type;
+};
+
+// name of the DataView accessor reading M, nullptr if there is none
+template <typename M>
+constexpr const char *DataViewType() {
+  if constexpr (std::is_same_v<M, float>) {
+    return "Float32";
+  } else if constexpr (std::is_same_v<M, double>) {
+    return "Float64";
+  } else if constexpr (std::is_integral_v<M>) {
+    constexpr bool is_signed = std::is_signed_v<M>;
+    switch (sizeof(M)) {
+      case 1:
+        return is_signed ? "Int8" : "Uint8";
+      case 2:
+        return is_signed ? "Int16" : "Uint16";
+      case 4:
+        return is_signed ? "Int32" : "Uint32";
+      case 8:
+        return is_signed ? "BigInt64" : "BigUint64";
+    }
+  }
+  return nullptr;
+}
+
 template <typename T>
 class ObjectFieldEntryStore {
  public:
@@ -1590,14 +4597,40 @@ class ObjectFieldEntryStore {
     return descriptors_;
   }
 
+  // whether a member holds JS handles, see holds_handles
+  static bool &holds_handles() {
+    static bool holds_handles_ = false;
+    return holds_handles_;
+  }
+
+  // members described by StructLayout<T>
+  static std::vector<StructField> &struct_fields() {
+    static std::vector<StructField> struct_fields_;
+    return struct_fields_;
+  }
+
   template <typename M>
   static void AddField(const char *name, M T::*m) {
     using Real = typename remove_optional<M>::type;
 
+    if (details::holds_handles<M>::Get()) {
+      holds_handles() = true;
+    }
+
+    if constexpr (std::is_trivially_copyable_v<T> &&
+                  DataViewType<M>() != nullptr) {
+      T obj{};
+      struct_fields().push_back(
+          {name,
+           static_cast<size_t>(reinterpret_cast<const char *>(&(obj.*m)) -
+                               reinterpret_cast<const char *>(&obj)),
+           DataViewType<M>()});
+    }
+
     descriptors().push_back(
-        {[name, m](Napi::Object js_obj, T &obj) -> bool {
-           std::optional<Real> v =
-               ValueTransformer<Real>::FromJS(js_obj.Get(name));
+        {name,
+         [m](Napi::Value value, T &obj) -> bool {
+           std::optional<Real> v = ValueTransformer<Real>::FromJS(value);
            if constexpr (!is_optional<M>::value) {
              if (!v.has_value()) {
                return false;
@@ -1620,22 +4653,64 @@ class ObjectFieldEntryStore {
              js_obj.Set(name, ValueTransformer<Real>::ToJS(js_obj.Env(),
                                                            std::move(obj.*m)));
            }
+         },
+         [](Napi::Value value) -> bool {
+           if constexpr (is_optional<M>::value) {
+             return true;
+           } else {
+             return (js_type_of<Real>::value & TypeOf(value, false)) !=
+                    JSType::kNone;
+           }
          }});
   }
 };
 
+template <typename T>
+struct holds_handles<T, std::enable_if_t<std::is_base_of_v<Object, T>>> {
+  static bool Get() { return ObjectFieldEntryStore<T>::holds_handles(); }
+};
+
 }  // namespace details
 
 template <typename T>
 struct ValueTransformer<T, std::enable_if_t<std::is_base_of_v<Object, T>>> {
+  static constexpr JSType kJSType = JSType::kAnyObject | JSType::kFunction;
+
   static std::optional<T> FromJS(Napi::Value value) {
     if (!value.IsObject()) {
       return {};
     }
-    Napi::Object obj = value.As<Napi::Object>();
+    return FromObject(value.As<Napi::Object>());
+  }
+
+  static std::optional<T> FromJS(Napi::Value value, JSType type) {
+    if ((type & kJSType) != type) {
+      return {};
+    }
+    return FromObject(value.As<Napi::Object>());
+  }
+
+  // reads every field once and checks their JS types before converting
+  // any, so a rejected variant alternative doesn't convert leading fields
+  static std::optional<T> FromObject(Napi::Object obj) {
+    auto &descriptors = details::ObjectFieldEntryStore<T>::descriptors();
+    constexpr size_t kInlineFields = 16;
+    Napi::Value inline_values[kInlineFields];
+    std::vector<Napi::Value> heap_values;
+    Napi::Value *values = inline_values;
+    if (descriptors.size() > kInlineFields) {
+      heap_values.resize(descriptors.size());
+      values = heap_values.data();
+    }
+    for (size_t i = 0; i < descriptors.size(); i++) {
+      values[i] = obj.Get(descriptors[i].name);
+      if (!descriptors[i].Accepts(values[i])) {
+        return {};
+      }
+    }
     T t;
-    for (auto &it : details::ObjectFieldEntryStore<T>::descriptors()) {
-      if (!it.FromJS(obj, t)) {
+    for (size_t i = 0; i < descriptors.size(); i++) {
+      if (!descriptors[i].FromJS(values[i], t)) {
         return {};
       }
     }
@@ -1651,6 +4726,100 @@ struct ValueTransformer<T, std::enable_if_t<std::is_base_of_v<Object, T>>> {
   }
 };
 
+namespace details {
+// bytes of an ArrayBuffer, a typed array or a DataView
+inline bool GetBufferBytes(napi_env env, napi_value value, void **data,
+                           size_t *length) {
+  if (napi_get_arraybuffer_info(env, value, data, length) == napi_ok) {
+    return true;
+  }
+  napi_typedarray_type type;
+  size_t element_length;
+  if (napi_get_typedarray_info(env, value, &type, &element_length, data,
+                               nullptr, nullptr) == napi_ok) {
+    size_t element_size = 1;
+    switch (type) {
+      case napi_int16_array:
+      case napi_uint16_array:
+        element_size = 2;
+        break;
+      case napi_int32_array:
+      case napi_uint32_array:
+      case napi_float32_array:
+        element_size = 4;
+        break;
+      case napi_float64_array:
+#if NAPI_VERSION > 5
+      case napi_bigint64_array:
+      case napi_biguint64_array:
+#endif
+        element_size = 8;
+        break;
+      default:
+        break;
+    }
+    *length = element_length * element_size;
+    return true;
+  }
+  return napi_get_dataview_info(env, value, length, data, nullptr, nullptr) ==
+         napi_ok;
+}
+}  // namespace details
+
+template <typename T>
+struct ValueTransformer<StructArray<T>> {
+  static constexpr JSType kJSType = JSType::kObject | JSType::kTypedArray;
+
+  static std::optional<StructArray<T>> FromJS(Napi::Value value) {
+    void *data = nullptr;
+    size_t length = 0;
+    if (!details::GetBufferBytes(value.Env(), value, &data, &length) ||
+        length % sizeof(T) != 0) {
+      return {};
+    }
+    // the bytes may not be aligned for T, copy them instead of the elements
+    StructArray<T> result(length / sizeof(T));
+    if (length > 0) {
+      std::memcpy(result.data(), data, length);
+    }
+    return result;
+  }
+
+  static Napi::Value ToJS(Napi::Env env, StructArray<T> arr) {
+    StructArray<T> *arr_ptr = new StructArray<T>(std::move(arr));
+    details::AdjustExternalMemory(env, details::BufferSlack(*arr_ptr));
+    return Napi::ArrayBuffer::New(
+        env, arr_ptr->data(), arr_ptr->size() * sizeof(T),
+        [](napi_env env, void *, void *hint) {
+          StructArray<T> *arr_ptr = static_cast<StructArray<T> *>(hint);
+          details::AdjustExternalMemory(env, -details::BufferSlack(*arr_ptr));
+          delete arr_ptr;
+        },
+        arr_ptr);
+  }
+};
+
+template <typename T>
+struct ValueTransformer<StructLayout<T>> {
+  static Napi::Value ToJS(Napi::Env env, StructLayout<T>) {
+    const uint16_t probe = 1;
+    Napi::Object fields = Napi::Object::New(env);
+    for (const details::StructField &field :
+         details::ObjectFieldEntryStore<T>::struct_fields()) {
+      Napi::Object desc = Napi::Object::New(env);
+      desc["offset"] = Napi::Number::New(env, field.offset);
+      desc["type"] = Napi::String::New(env, field.type);
+      fields[field.name] = desc;
+    }
+    Napi::Object layout = Napi::Object::New(env);
+    layout["stride"] = Napi::Number::New(env, sizeof(T));
+    layout["littleEndian"] = Napi::Boolean::New(
+        env, *reinterpret_cast<const uint8_t *>(&probe) == 1);
+    layout["fields"] = fields;
+    return layout;
+  }
+};
+
 template <typename T>
 template <auto T::*m>
 inline ObjectRegistration<T> ObjectRegistration<T>::Member(const char *name) {
@@ -1665,48 +4834,25 @@ inline ObjectRegistration<T> Registration::Object() {
 
 }  // namespace naah
 
+#define NAAH_INTERNED_STRING(literal) \
+  naah::InternedString::Of([] { return std::string_view(literal); })
+
 #define NAAH_EXPORT                                   \
   using NAAH_REGISTRATION_ADDON = naah::Registration; \
   NODE_API_ADDON(NAAH_REGISTRATION_ADDON)
 
-#ifndef NAAH_CDECL
-#ifdef _WIN32
-#define NAAH_CDECL __cdecl
-#else
-#define NAAH_CDECL
-#endif
-#endif
-
-#if defined(_MSC_VER)
-#if defined(__cplusplus)
-#define NAAH_C_CTOR(fn)            \
-  static void NAAH_CDECL fn(void); \
-  namespace {                      \
-  struct fn##_ {                   \
-    fn##_() { fn(); }              \
-  } fn##_v_;                       \
-  }                                \
-  static void NAAH_CDECL fn(void)
-#else  // !defined(__cplusplus)
-#pragma section(".CRT$XCU", read)
-// The NAAH_C_CTOR macro defines a function fn that is called during CRT
-// initialization.
-// C does not support dynamic initialization of static variables and this code
-// simulates C++ behavior. Exporting the function pointer prevents it from being
-// optimized. See for details:
-// https://docs.microsoft.com/en-us/cpp/c-runtime-library/crt-initialization?view=msvc-170
-#define NAAH_C_CTOR(fn)                                                        \
-  static void NAAH_CDECL fn(void);                                             \
-  __declspec(dllexport, allocate(".CRT$XCU")) void(NAAH_CDECL * fn##_)(void) = \
-      fn;                                                                      \
-  static void NAAH_CDECL fn(void)
-#endif  // defined(__cplusplus)
+// runs once like a static constructor, optimize it for size like one
+#if defined(__GNUC__)
+#define NAAH_REGISTRATION_ATTRIBUTES __attribute__((cold))
 #else
-#define NAAH_C_CTOR(fn)                              \
-  static void fn(void) __attribute__((constructor)); \
-  static void fn(void)
+#define NAAH_REGISTRATION_ATTRIBUTES
 #endif
 
-#define NAAH_REGISTRATION NAAH_C_CTOR(napi_helper_auto_register_function_)
+#define NAAH_REGISTRATION                                                  \
+  NAAH_REGISTRATION_ATTRIBUTES static void                                 \
+  napi_helper_auto_register_function_();                                   \
+  static naah::details::RegistrationHook napi_helper_auto_register_hook_( \
+      napi_helper_auto_register_function_);                                \
+  static void napi_helper_auto_register_function_()
 
 #endif  // SRC_NAAH_INL_H_
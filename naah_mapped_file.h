@@ -0,0 +1,262 @@
+#ifndef SRC_NAAH_MAPPED_FILE_H_
+#define SRC_NAAH_MAPPED_FILE_H_
+
+// MappedFile is opt-in, so that the platform headers it needs (windows.h,
+// sys/mman.h, ...) aren't included by every user of naah.h
+
+#include <naah.h>
+
+#include <cstring>
+#include <mutex>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace naah {
+
+namespace details {
+// a mapped file, unmapped on destruction
+class FileMapping {
+ public:
+  NAPI_DISALLOW_ASSIGN_COPY(FileMapping)
+
+  FileMapping(void *data, size_t size) : data(data), size(size) {}
+
+  ~FileMapping() {
+#ifdef _WIN32
+    UnmapViewOfFile(data);
+#else
+    munmap(data, size);
+#endif
+  }
+
+  void *const data;
+  const size_t size;
+
+  // the external ArrayBuffer over the whole mapping, which holds it until
+  // finalized. V8 must not be given the same memory twice, so all views
+  // returned to its env share it, weakly referenced by `buffer`.
+  std::mutex mutex;
+  napi_env buffer_env = nullptr;
+  napi_ref buffer = nullptr;
+};
+}  // namespace details
+
+// a file mapped into memory, returned as a Uint8Array over an external
+// ArrayBuffer of the mapping without reading the file. Pages are shared with
+// the page cache of other processes, writes from JS are private copies. The
+// views made by Slice share the mapping and its ArrayBuffer, it's unmapped
+// when the last one is collected.
+class MappedFile {
+ public:
+  // madvise hints for the pages of a view
+  enum class Advice { kNormal, kSequential, kRandom, kWillNeed };
+
+  MappedFile() = default;
+
+  static Result<MappedFile, Error> Open(const std::string &path,
+                                        Advice advice = Advice::kNormal);
+
+  const char *data() const NAPI_NOEXCEPT;
+  size_t size() const NAPI_NOEXCEPT;
+
+  // length bytes at offset of this view, clamped to its end
+  MappedFile Slice(size_t offset, size_t length = SIZE_MAX) const;
+
+  // ignored where unsupported
+  void Advise(Advice advice) const;
+
+ private:
+  std::shared_ptr<details::FileMapping> _mapping;
+  const char *_data = nullptr;
+  size_t _size = 0;
+
+  friend struct ValueTransformer<MappedFile>;
+};
+
+inline Result<MappedFile, Error> MappedFile::Open(const std::string &path,
+                                                  Advice advice) {
+  void *data = nullptr;
+  size_t size = 0;
+#ifdef _WIN32
+  HANDLE file = CreateFileA(path.c_str(), GENERIC_READ,
+                            FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    return Error("failed to open " + path);
+  }
+  LARGE_INTEGER file_size;
+  if (!GetFileSizeEx(file, &file_size)) {
+    CloseHandle(file);
+    return Error("failed to stat " + path);
+  }
+  size = static_cast<size_t>(file_size.QuadPart);
+  if (size > 0) {
+    // copy on write, like a private mapping
+    HANDLE mapping =
+        CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+    if (mapping != nullptr) {
+      data = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+      CloseHandle(mapping);
+    }
+  }
+  CloseHandle(file);
+  if (size > 0 && data == nullptr) {
+    return Error("failed to map " + path);
+  }
+#else
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return Error("failed to open " + path);
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return Error("failed to stat " + path);
+  }
+  size = static_cast<size_t>(st.st_size);
+  if (size > 0) {
+    // private so that writes from JS are copies instead of faults
+    data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  }
+  close(fd);
+  if (data == MAP_FAILED) {
+    return Error("failed to map " + path);
+  }
+#endif
+  MappedFile file;
+  if (size > 0) {
+    file._mapping = std::make_shared<details::FileMapping>(data, size);
+    file._data = static_cast<const char *>(data);
+    file._size = size;
+    if (advice != Advice::kNormal) {
+      file.Advise(advice);
+    }
+  }
+  return file;
+}
+
+inline const char *MappedFile::data() const NAPI_NOEXCEPT { return _data; }
+
+inline size_t MappedFile::size() const NAPI_NOEXCEPT { return _size; }
+
+inline MappedFile MappedFile::Slice(size_t offset, size_t length) const {
+  MappedFile view(*this);
+  offset = std::min(offset, _size);
+  view._data = _data + offset;
+  view._size = std::min(length, _size - offset);
+  return view;
+}
+
+inline void MappedFile::Advise(Advice advice) const {
+#ifndef _WIN32
+  if (_size == 0) {
+    return;
+  }
+  // madvise takes page aligned addresses
+  const uintptr_t page = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+  uintptr_t begin = reinterpret_cast<uintptr_t>(_data) & ~(page - 1);
+  size_t length = reinterpret_cast<uintptr_t>(_data) + _size - begin;
+  int hint = MADV_NORMAL;
+  switch (advice) {
+    case Advice::kNormal:
+      break;
+    case Advice::kSequential:
+      hint = MADV_SEQUENTIAL;
+      break;
+    case Advice::kRandom:
+      hint = MADV_RANDOM;
+      break;
+    case Advice::kWillNeed:
+      hint = MADV_WILLNEED;
+      break;
+  }
+  madvise(reinterpret_cast<void *>(begin), length, hint);
+#else
+  (void)advice;
+#endif
+}
+
+template <>
+struct ValueTransformer<MappedFile> {
+  static Napi::Value ToJS(Napi::Env env, MappedFile file) {
+    if (file._size == 0) {
+      return Napi::Uint8Array::New(env, 0);
+    }
+    details::FileMapping &mapping = *file._mapping;
+    size_t offset = file._data - static_cast<const char *>(mapping.data);
+
+    napi_value buffer = nullptr;
+    {
+      std::lock_guard<std::mutex> lock(mapping.mutex);
+      if (mapping.buffer != nullptr) {
+        // null once collected, the memory stays registered until finalized
+        if (mapping.buffer_env == env) {
+          napi_get_reference_value(env, mapping.buffer, &buffer);
+        }
+      } else {
+        buffer = NewBuffer(env, file._mapping);
+        if (env.IsExceptionPending()) {
+          return Napi::Value();
+        }
+      }
+    }
+
+    if (buffer == nullptr) {
+      // another env holds the memory or it's about to be released, or
+      // external buffers aren't allowed at all
+      Napi::ArrayBuffer copy = Napi::ArrayBuffer::New(env, file._size);
+      std::memcpy(copy.Data(), file._data, file._size);
+      return Napi::Uint8Array::New(env, file._size, copy, 0);
+    }
+    return Napi::Uint8Array::New(env, file._size,
+                                 Napi::ArrayBuffer(env, buffer), offset);
+  }
+
+ private:
+  // nullptr if the runtime doesn't allow external buffers, called with the
+  // mutex of the mapping held
+  static napi_value NewBuffer(
+      Napi::Env env, const std::shared_ptr<details::FileMapping> &mapping) {
+    auto *holder = new std::shared_ptr<details::FileMapping>(mapping);
+    napi_value buffer;
+    napi_status status = napi_create_external_arraybuffer(
+        env, mapping->data, mapping->size,
+        [](napi_env env, void *, void *hint) {
+          auto *holder =
+              static_cast<std::shared_ptr<details::FileMapping> *>(hint);
+          details::FileMapping &mapping = **holder;
+          {
+            std::lock_guard<std::mutex> lock(mapping.mutex);
+            napi_delete_reference(env, mapping.buffer);
+            mapping.buffer = nullptr;
+            mapping.buffer_env = nullptr;
+          }
+          delete holder;
+        },
+        holder, &buffer);
+    if (status == napi_no_external_buffers_allowed) {
+      delete holder;
+      return nullptr;
+    }
+    NAPI_THROW_IF_FAILED(env, status, nullptr);
+
+    status = napi_create_reference(env, buffer, 0, &mapping->buffer);
+    NAPI_THROW_IF_FAILED(env, status, nullptr);
+    mapping->buffer_env = env;
+    return buffer;
+  }
+};
+
+}  // namespace naah
+
+#endif  // SRC_NAAH_MAPPED_FILE_H_
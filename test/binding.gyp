@@ -25,6 +25,16 @@
             'sources': ['>@(binding_sources)'],
             'defines': [ 'NAPI_CPP_CUSTOM_NAMESPACE=MyCustomNapi' ]
         },
+        {
+            'target_name': 'binding_external_strings',
+            'includes': ['./common.gypi', './except.gypi'],
+            'sources': ['>@(binding_sources)'],
+            # external strings are experimental before Node-API 10
+            'defines': [
+                'NAPI_EXPERIMENTAL',
+                'NODE_API_EXPERIMENTAL_BASIC_ENV_OPT_OUT'
+            ]
+        },
         {
             'target_name': 'binding_noexcept',
             'includes': ['./common.gypi', './noexcept.gypi'],
@@ -39,6 +49,12 @@
             'target_name': 'registration_noexcept',
             'includes': ['./common.gypi', './noexcept.gypi'],
             'sources': ['>@(registration_sources)']
+        },
+        {
+            'target_name': 'registration_lazy',
+            'includes': ['./common.gypi', './except.gypi'],
+            'sources': ['>@(registration_sources)'],
+            'defines': [ 'NAAH_TEST_LAZY_CLASSES' ]
         }
     ]
 }
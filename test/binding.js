@@ -10,6 +10,10 @@ exports.forEachBinding = cb => {
     cb(bindings('binding_namespace.node'))
   })
 
+  describe('Exception with external strings', () => {
+    cb(bindings('binding_external_strings.node'))
+  })
+
   describe('No Exception', () => {
     cb(bindings('binding_noexcept.node'))
   })
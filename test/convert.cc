@@ -20,6 +20,18 @@ auto FnLambda(uint32_t num) {
   };
 }
 
+// compiles to a static callback, without an allocation
+auto FnStateless() {
+  return [](uint32_t a, uint32_t b) -> uint32_t { return a * b; };
+}
+
+// called as const from a static otherwise
+auto FnStatelessMutable() {
+  return [](uint32_t a) mutable -> uint32_t { return a + 1; };
+}
+
+uint32_t fn_data = 42;
+
 auto FnFunction(uint32_t num) {
   return std::function([num](uint32_t n) -> uint32_t { return num + n; });
 }
@@ -70,11 +82,27 @@ Napi::Object InitConvert(Napi::Env env) {
   obj["stringView"] = naah::ConvertToJS(env, std::string_view("stringView"));
   obj["u16stringView"] =
       naah::ConvertToJS(env, std::u16string_view(u"u16stringView"));
+  obj["interned"] = naah::ConvertToJS(env, NAAH_INTERNED_STRING("interned"));
 
   obj["customMethod"] = naah::details::Function::New<CustomMethod>(env);
 
   obj["fnLambda"] = naah::details::Function::New<FnLambda>(env);
   obj["fnFunction"] = naah::details::Function::New<FnFunction>(env);
+  obj["fnStateless"] = naah::details::Function::New<FnStateless>(env);
+  obj["fnStatelessMutable"] =
+      naah::details::Function::New<FnStatelessMutable>(env);
+  obj["fnStatelessData"] = naah::details::Function::New(
+      env,
+      [](const Napi::CallbackInfo &info) -> uint32_t {
+        return *static_cast<uint32_t *>(info.Data());
+      },
+      "fnStatelessData", &fn_data);
+  obj["fnClosureData"] = naah::details::Function::New(
+      env,
+      [add = uint32_t(1)](const Napi::CallbackInfo &info) -> uint32_t {
+        return *static_cast<uint32_t *>(info.Data()) + add;
+      },
+      "fnClosureData", &fn_data);
 
   obj["errorFunction"] = naah::details::Function::New<ErrorFunction>(env);
   obj["rangeErrorFunction"] =
@@ -8,6 +8,7 @@ forEachBinding(({ convert }) => {
       expect(convert.hehe).to.eq('hehe')
       expect(convert.stringView).to.eq('stringView')
       expect(convert.u16stringView).to.eq('u16stringView')
+      expect(convert.interned).to.eq('interned')
     })
 
     it('convert function', () => {
@@ -15,6 +16,16 @@ forEachBinding(({ convert }) => {
       expect(convert.fnFunction(4)(4)).to.eq(8)
     })
 
+    it('convert stateless and capturing lambdas', () => {
+      expect(convert.fnStateless()(6, 7)).to.eq(42)
+      expect(convert.fnStateless()(7, 8)).to.eq(56)
+      expect(convert.fnStatelessMutable()(41)).to.eq(42)
+      expect(convert.fnStatelessData()).to.eq(42)
+      expect(convert.fnClosureData()).to.eq(43)
+      const fns = Array.from({ length: 10000 }, (_, i) => convert.fnLambda(i))
+      expect(fns.reduce((sum, fn) => sum + fn(1), 0)).to.eq(50005000)
+    })
+
     it('convert error', () => {
       expect(convert.errorFunction()).to.be.instanceOf(Error)
       expect(convert.rangeErrorFunction()).to.be.instanceOf(RangeError)
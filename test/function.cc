@@ -1,4 +1,5 @@
 #include <naah.h>
+#include <naah_mapped_file.h>
 
 namespace {
 uint32_t ArgsCallback(int32_t num1, std::optional<uint32_t> num2,
@@ -145,10 +146,43 @@ int64_t Int64Callback(int64_t num) { return num + 42; }
 
 uint64_t Uint64Callback(uint64_t num) { return num + 233; }
 
+naah::SafeInt64 SafeInt64Callback(naah::SafeInt64 num) { return num - 42; }
+
+naah::SafeUint64 SafeUint64Callback(naah::SafeUint64 num) { return num + 1; }
+
 std::string StrCallback(std::string str) { return str + "!!"; }
 
 std::u16string U16StrCallback(std::u16string str) { return str + u"??"; }
 
+std::string StrViewCallback(std::string_view str) {
+  return std::string(str) + "!!";
+}
+
+std::u16string U16StrViewCallback(std::u16string_view str) {
+  return std::u16string(str) + u"??";
+}
+
+// the views must survive nested native calls made by the callback
+std::string StrViewReentrant(std::string_view a, Napi::Function fn,
+                             std::u16string_view b) {
+  fn.Call({});
+  return std::string(a) + std::to_string(b.size());
+}
+
+// views nested in containers get the arena of the call as well
+uint32_t StrViewVector(std::vector<std::string_view> strs) {
+  uint32_t size = 0;
+  for (std::string_view str : strs) {
+    size += str.size();
+  }
+  return size;
+}
+
+// no arena is set up for functions not taking views
+bool StrViewWithoutArena(Napi::Value str) {
+  return naah::ValueTransformer<std::string_view>::FromJS(str).has_value();
+}
+
 std::vector<uint32_t> VectorCallback(std::vector<uint32_t> arr) {
   for (auto &num : arr) {
     num++;
@@ -156,6 +190,58 @@ std::vector<uint32_t> VectorCallback(std::vector<uint32_t> arr) {
   return arr;
 }
 
+std::map<std::string, uint32_t> MapCallback(
+    std::map<std::string, uint32_t> map) {
+  for (auto &[key, num] : map) {
+    num += key.size();
+  }
+  return map;
+}
+
+std::unordered_map<uint32_t, std::string> UnorderedMapCallback(
+    std::unordered_map<uint32_t, std::string> map) {
+  map.emplace(map.size(), "new");
+  return map;
+}
+
+naah::JSMap<std::unordered_map<std::string, uint32_t>> JSMapCallback(
+    naah::JSMap<std::unordered_map<std::string, uint32_t>> map) {
+  map["size"] = map.size();
+  return map;
+}
+
+std::set<uint32_t> SetCallback(std::set<uint32_t> set) {
+  set.insert(set.size());
+  return set;
+}
+
+std::unordered_set<std::string> UnorderedSetCallback(
+    std::unordered_set<std::string> set) {
+  set.insert("new");
+  return set;
+}
+
+// handles of the elements must outlive the conversion
+std::vector<Napi::Object> ObjectsCallback(std::vector<Napi::Object> objs) {
+  return objs;
+}
+
+std::map<std::string, Napi::Object> ObjectMapCallback(
+    std::map<std::string, Napi::Object> map) {
+  return map;
+}
+
+std::map<uint32_t, Napi::Object> ObjectJSMapCallback(
+    std::map<uint32_t, Napi::Object> map) {
+  return map;
+}
+
+// elements are converted in handle scopes of their own, nested ones too
+std::vector<std::map<std::string, std::vector<std::string>>> NestedCallback(
+    std::vector<std::map<std::string, std::vector<std::string>>> arr) {
+  return arr;
+}
+
 std::tuple<uint32_t, std::optional<std::string>> TupleCallback(
     std::tuple<std::string, std::optional<uint32_t>> input) {
   std::optional<std::string> ret1;
@@ -179,6 +265,12 @@ std::variant<uint32_t, std::string> FunctionWithVariants(
   return std::visit(Visitor(), input);
 }
 
+uint32_t VariantKind(std::variant<std::vector<uint32_t>, naah::Float64Array,
+                                  std::string, Napi::Date, Napi::Object, bool>
+                         input) {
+  return input.index();
+}
+
 #ifdef NAPI_CPP_EXCEPTIONS
 
 std::string FunctionThrows(uint32_t i) {
@@ -198,8 +290,118 @@ naah::Result<std::string, naah::RangeError> FunctionThrows(uint32_t i) {
 }
 
 #endif
+
+// context parameters take no JS argument, wherever they are
+uint32_t ContextParams(uint32_t a, naah::CallArena &arena, Napi::Env env,
+                       uint32_t b, naah::CallStats &stats,
+                       naah::StopToken token) {
+  uint32_t *sums = arena.Allocate<uint32_t>(64);
+  for (size_t i = 0; i < 64; i++) {
+    sums[i] = a + b;
+  }
+  if (!env.Global().IsObject() || token.stop_requested() ||
+      stats.Elapsed() < stats.conversion()) {
+    return 0;
+  }
+  return sums[63] + stats.argc() * 1000;
+}
+
+// names are converted only if they're read, and once
+int32_t LazyNames(uint32_t n,
+                  std::optional<naah::Lazy<std::vector<std::string>>> names) {
+  if (n == 0 || !names.has_value()) {
+    return 0;
+  }
+  std::optional<std::vector<std::string>> &converted = names->get();
+  if (!converted.has_value() || &names->get() != &converted) {
+    return -1;
+  }
+  return converted->size();
+}
+
+naah::Result<naah::Out<naah::Float32Array>, naah::RangeError> ScaleInto(
+    Napi::Float32Array input, float k, naah::Out<naah::Float32Array> out) {
+  if (!out.Resize(input.ElementLength())) {
+    return naah::RangeError("output length mismatch");
+  }
+  for (size_t i = 0; i < out.size(); i++) {
+    out[i] = input.Data()[i] * k;
+  }
+  return out;
+}
+
+// returned as the JS value it was passed as, never converted
+naah::Lazy<std::string> LazyEcho(naah::Lazy<std::string> str) { return str; }
+
+// the caller's typed array, or an empty one when undefined is passed
+naah::Out<naah::Uint8Array> OutUntouched(naah::Out<naah::Uint8Array> out) {
+  return out;
+}
+
+naah::Result<naah::MappedFile, naah::Error> MapFile(
+    std::string path, std::optional<uint32_t> offset,
+    std::optional<uint32_t> length) {
+  naah::Result<naah::MappedFile, naah::Error> file =
+      naah::MappedFile::Open(path, naah::MappedFile::Advice::kSequential);
+  if (file.value.has_value() && offset.has_value()) {
+    return file.value->Slice(*offset, length.value_or(SIZE_MAX));
+  }
+  return file;
+}
+
+// views of one mapping share its ArrayBuffer
+std::vector<naah::MappedFile> MapFileTwice(std::string path) {
+  naah::MappedFile file = *naah::MappedFile::Open(path).value;
+  return {file, file, file.Slice(6, 7)};
+}
+
+naah::ExternalString<> ExternalString(std::string str, uint32_t times) {
+  std::string result;
+  for (uint32_t i = 0; i < times; i++) {
+    result += str;
+  }
+  return result;
+}
+
+naah::ExternalString<std::u16string> ExternalU16String(
+    naah::ExternalString<std::u16string> str) {
+  return str + u"!";
+}
+
+// counts the copies and moves since it was converted
+struct Tracked {
+  Tracked() = default;
+  Tracked(const Tracked &other) : transfers(other.transfers + 1) {}
+  Tracked(Tracked &&other) : transfers(other.transfers + 1) {}
+
+  uint32_t transfers = 0;
+};
+
+uint32_t TrackedByValue(Tracked t) { return t.transfers; }
+
+uint32_t TrackedByConstRef(const Tracked &t) { return t.transfers; }
+
+uint32_t TrackedByRvalueRef(Tracked &&t) { return t.transfers; }
+
+uint32_t TrackedOptional(std::optional<Tracked> a, const Tracked &b) {
+  return a->transfers * 10 + b.transfers;
+}
+
+const std::string &ConstRefReturn() {
+  static const std::string str = "by reference";
+  return str;
+}
 }  // namespace
 
+namespace naah {
+template <>
+struct ValueTransformer<Tracked> {
+  static std::optional<Tracked> FromJS(Napi::Value) {
+    return std::make_optional<Tracked>();
+  }
+};
+}  // namespace naah
+
 Napi::Object InitFunction(Napi::Env env) {
   Napi::Object obj = Napi::Object::New(env);
 
@@ -267,13 +469,67 @@ Napi::Object InitFunction(Napi::Env env) {
   obj["int32Callback"] = naah::details::Function::New<Int32Callback>(env);
   obj["int64Callback"] = naah::details::Function::New<Int64Callback>(env);
   obj["uint64Callback"] = naah::details::Function::New<Uint64Callback>(env);
+  obj["safeInt64Callback"] =
+      naah::details::Function::New<SafeInt64Callback>(env);
+  obj["safeUint64Callback"] =
+      naah::details::Function::New<SafeUint64Callback>(env);
   obj["strCallback"] = naah::details::Function::New<StrCallback>(env);
   obj["u16strCallback"] = naah::details::Function::New<U16StrCallback>(env);
+  obj["strViewCallback"] = naah::details::Function::New<StrViewCallback>(env);
+  obj["u16strViewCallback"] =
+      naah::details::Function::New<U16StrViewCallback>(env);
+  obj["strViewReentrant"] =
+      naah::details::Function::New<StrViewReentrant>(env);
+  obj["strViewVector"] = naah::details::Function::New<StrViewVector>(env);
+  obj["strViewWithoutArena"] =
+      naah::details::Function::New<StrViewWithoutArena>(env);
 
   obj["vectorCallback"] = naah::details::Function::New<VectorCallback>(env);
+  obj["mapCallback"] = naah::details::Function::New<MapCallback>(env);
+  obj["unorderedMapCallback"] =
+      naah::details::Function::New<UnorderedMapCallback>(env);
+  obj["jsMapCallback"] = naah::details::Function::New<JSMapCallback>(env);
+  obj["setCallback"] = naah::details::Function::New<SetCallback>(env);
+  obj["unorderedSetCallback"] =
+      naah::details::Function::New<UnorderedSetCallback>(env);
+  obj["nestedCallback"] = naah::details::Function::New<NestedCallback>(env);
+  obj["objectsCallback"] = naah::details::Function::New<ObjectsCallback>(env);
+  obj["objectMapCallback"] =
+      naah::details::Function::New<ObjectMapCallback>(env);
+  obj["objectJSMapCallback"] =
+      naah::details::Function::New<ObjectJSMapCallback>(env);
   obj["tupleCallback"] = naah::details::Function::New<TupleCallback>(env);
   obj["functionWithVariants"] =
       naah::details::Function::New<FunctionWithVariants>(env);
+  obj["variantKind"] = naah::details::Function::New<VariantKind>(env);
+
+  obj["trackedByValue"] = naah::details::Function::New<TrackedByValue>(env);
+  obj["trackedByConstRef"] =
+      naah::details::Function::New<TrackedByConstRef>(env);
+  obj["trackedByRvalueRef"] =
+      naah::details::Function::New<TrackedByRvalueRef>(env);
+  obj["trackedOptional"] = naah::details::Function::New<TrackedOptional>(env);
+  obj["trackedLambda"] =
+      naah::details::Function::New(env, [](Tracked a, Tracked &&b) {
+        return a.transfers * 10 + b.transfers;
+      });
+  obj["constRefReturn"] = naah::details::Function::New<ConstRefReturn>(env);
+
+  obj["contextParams"] = naah::details::Function::New<ContextParams>(env);
+  obj["lazyNames"] = naah::details::Function::New<LazyNames>(env);
+  obj["lazyEcho"] = naah::details::Function::New<LazyEcho>(env);
+  obj["scaleInto"] = naah::details::Function::New<ScaleInto>(env);
+  obj["outUntouched"] = naah::details::Function::New<OutUntouched>(env);
+  obj["mapFile"] = naah::details::Function::New<MapFile>(env);
+  obj["mapFileTwice"] = naah::details::Function::New<MapFileTwice>(env);
+  obj["externalString"] = naah::details::Function::New<ExternalString>(env);
+  obj["externalU16String"] =
+      naah::details::Function::New<ExternalU16String>(env);
+#ifdef NAAH_EXTERNAL_STRINGS
+  obj["externalStrings"] = Napi::Boolean::New(env, true);
+#else
+  obj["externalStrings"] = Napi::Boolean::New(env, false);
+#endif
 
   obj["voidCallback"] = naah::details::Function::New<VoidCallback>(env);
 
@@ -1,3 +1,4 @@
+const fs = require('fs')
 const { expect } = require('chai')
 const { forEachBinding } = require('./binding')
 
@@ -48,12 +49,89 @@ forEachBinding(bindings => {
         BigInt(Number.MAX_SAFE_INTEGER),
         BigInt(Number.MAX_SAFE_INTEGER) + 233n
       ],
+      [
+        'safeInt64Callback',
+        42,
+        0,
+        -Number.MAX_SAFE_INTEGER + 42,
+        -Number.MAX_SAFE_INTEGER,
+        -Number.MAX_SAFE_INTEGER + 41,
+        -(2n ** 53n),
+        2n ** 62n,
+        2n ** 62n - 42n
+      ],
+      [
+        'safeUint64Callback',
+        1,
+        2,
+        Number.MAX_SAFE_INTEGER - 1,
+        Number.MAX_SAFE_INTEGER,
+        Number.MAX_SAFE_INTEGER,
+        2n ** 53n,
+        2n ** 53n,
+        2n ** 53n + 1n
+      ],
       ['strCallback', 'hello', 'hello!!'],
       ['u16strCallback', 'hello', 'hello??'],
+      ['strViewCallback', 'hello', 'hello!!', '你好😀', '你好😀!!'],
+      ['u16strViewCallback', 'hello', 'hello??', '你好😀', '你好😀??'],
 
       [true, 'vectorCallback', [1, 2, 3], [2, 3, 4]],
+      [
+        true,
+        'mapCallback',
+        { a: 1, bc: 2, '\u00e9\u0000': 3, 0: 4 },
+        { a: 2, bc: 4, '\u00e9\u0000': 6, 0: 5 },
+        {},
+        {}
+      ],
+      [
+        true,
+        'unorderedMapCallback',
+        new Map([[3, 'c']]),
+        new Map([[3, 'c'], [1, 'new']])
+      ],
+      [
+        true,
+        'jsMapCallback',
+        new Map([['a', 1], ['b', 2]]),
+        new Map([['a', 1], ['b', 2], ['size', 2]])
+      ],
+      [
+        true,
+        'setCallback',
+        new Set([5, 1]),
+        new Set([1, 2, 5]),
+        [0],
+        new Set([0, 1])
+      ],
+      [
+        true,
+        'unorderedSetCallback',
+        new Set(['a']),
+        new Set(['a', 'new'])
+      ],
       [true, 'tupleCallback', ['233'], [3, undefined], ['42', 233], [2, '233']],
       ['functionWithVariants', '42', 2, 233, '233'],
+      [
+        'variantKind',
+        [1, 2],
+        0,
+        new Float64Array(2),
+        1,
+        'str',
+        2,
+        new Uint8Array(2),
+        4,
+        ['str'],
+        4,
+        new Date(42),
+        3,
+        {},
+        4,
+        true,
+        5
+      ],
       ['voidCallback', 1, undefined],
 
       ['undefinedCallback', undefined, undefined],
@@ -156,6 +234,214 @@ forEachBinding(bindings => {
       })
     })
 
+    it('calls strViewCallback with long strings', () => {
+      for (const size of [250, 253, 256, 1000, 20000, 2000000]) {
+        const str = 'a'.repeat(size - 1) + '😀'
+        expect(bindings.function.strViewCallback(str)).to.equal(str + '!!')
+        expect(bindings.function.u16strViewCallback(str)).to.equal(str + '??')
+      }
+    })
+
+    it('keeps string views valid across nested calls', () => {
+      const a = 'a'.repeat(300)
+      const b = 'b'.repeat(30000)
+      const result = bindings.function.strViewReentrant(a, () => {
+        expect(bindings.function.strViewCallback('c'.repeat(40000))).to.equal(
+          'c'.repeat(40000) + '!!'
+        )
+        expect(
+          bindings.function.strViewReentrant('d'.repeat(100), () => {}, 'e')
+        ).to.equal('d'.repeat(100) + '1')
+      }, b)
+      expect(result).to.equal(a + '30000')
+    })
+
+    it('converts string views only inside calls taking them', () => {
+      expect(bindings.function.strViewVector(['a'.repeat(300), 'bc'])).to.equal(302)
+      expect(() => bindings.function.strViewWithoutArena('abc')).to.throw(
+        Error,
+        'string views can only be converted for arguments of a native call'
+      )
+    })
+
+    it('converts __proto__ keys as own properties', () => {
+      const result = bindings.function.mapCallback(JSON.parse('{"__proto__": 1}'))
+      expect(Object.getPrototypeOf(result)).to.eq(Object.prototype)
+      expect(Object.keys(result)).to.eql(['__proto__'])
+      expect(Object.getOwnPropertyDescriptor(result, '__proto__').value).to.eq(10)
+    })
+
+    it('throws for mismatched collections', () => {
+      for (const [fn, arg] of [
+        ['mapCallback', { a: 'b' }],
+        ['unorderedMapCallback', { 1: 'a' }],
+        ['unorderedMapCallback', new Map([['1', 'a']])],
+        ['jsMapCallback', { a: 1 }],
+        ['mapCallback', [1, 2]],
+        ['mapCallback', new Uint8Array(2)],
+        ['mapCallback', new Map([['a', 1]])],
+        ['mapCallback', new Set(['a'])],
+        ['objectMapCallback', [{}]],
+        ['objectMapCallback', new Map([['a', {}]])],
+        ['setCallback', new Set(['a'])],
+        ['setCallback', 1]
+      ]) {
+        expect(() => bindings.function[fn](arg)).to.throw(TypeError)
+      }
+    })
+
+    it('converts containers larger than a handle scope chunk', () => {
+      const arr = Array.from({ length: 1000 }, (_, i) =>
+        Object.fromEntries(
+          Array.from({ length: i % 300 }, (_, j) => ['k' + j, [String(i), 'v']])
+        )
+      )
+      expect(bindings.function.nestedCallback(arr)).to.eql(arr)
+      expect(() => bindings.function.nestedCallback([...arr, { a: [1] }])).to.throw(
+        TypeError
+      )
+    })
+
+    it('keeps handles of converted elements', () => {
+      const objs = Array.from({ length: 300 }, (_, i) => ({ i }))
+      const result = bindings.function.objectsCallback(objs)
+      expect(result).to.have.lengthOf(300)
+      result.forEach((obj, i) => expect(obj).to.eq(objs[i]))
+    })
+
+    it('keeps handles of converted map entries', () => {
+      const objs = Array.from({ length: 300 }, (_, i) => ({ i }))
+      const record = Object.fromEntries(objs.map((obj, i) => ['k' + i, obj]))
+      const result = bindings.function.objectMapCallback(record)
+      expect(Object.keys(result)).to.have.lengthOf(300)
+      objs.forEach((obj, i) => expect(result['k' + i]).to.eq(obj))
+
+      const map = new Map(objs.map((obj, i) => [i, obj]))
+      const jsMap = bindings.function.objectJSMapCallback(map)
+      expect(jsMap.size).to.eq(300)
+      objs.forEach((obj, i) => expect(jsMap.get(i)).to.eq(obj))
+    })
+
+    it('moves arguments at most once', () => {
+      expect(bindings.function.trackedByValue(0)).to.eq(1)
+      expect(bindings.function.trackedByConstRef(0)).to.eq(0)
+      expect(bindings.function.trackedByRvalueRef(0)).to.eq(0)
+      expect(bindings.function.trackedOptional(0, 0)).to.eq(10)
+      expect(bindings.function.trackedLambda(0, 0)).to.eq(10)
+    })
+
+    it('supplies context parameters', () => {
+      expect(bindings.function.contextParams(1, 2)).to.eq(2003)
+      expect(bindings.function.contextParams(1, 2, 3)).to.eq(3003)
+      expect(() => bindings.function.contextParams(1)).to.throw(TypeError)
+    })
+
+    it('converts lazy arguments when they are read', () => {
+      expect(bindings.function.lazyNames(1, ['a', 'b'])).to.eq(2)
+      expect(bindings.function.lazyNames(1)).to.eq(0)
+      expect(bindings.function.lazyNames(0, [1])).to.eq(0)
+      expect(bindings.function.lazyNames(1, [1])).to.eq(-1)
+      expect(bindings.function.lazyNames(1, 'a')).to.eq(0)
+    })
+
+    it('returns lazy arguments as they were passed', () => {
+      expect(bindings.function.lazyEcho('abc')).to.eq('abc')
+      expect(() => bindings.function.lazyEcho(1)).to.throw(TypeError)
+      expect(() => bindings.function.lazyEcho()).to.throw(TypeError)
+    })
+
+    it('writes into caller provided typed arrays', () => {
+      const input = new Float32Array([1, 2, 3])
+      const out = new Float32Array(3)
+      expect(bindings.function.scaleInto(input, 2, out)).to.eq(out)
+      expect(out).to.eql(new Float32Array([2, 4, 6]))
+      expect(bindings.function.scaleInto(input, 3)).to.eql(
+        new Float32Array([3, 6, 9])
+      )
+      expect(() =>
+        bindings.function.scaleInto(input, 2, new Float32Array(2))
+      ).to.throw(RangeError, 'output length mismatch')
+      expect(() =>
+        bindings.function.scaleInto(input, 2, new Float64Array(3))
+      ).to.throw(TypeError)
+    })
+
+    it('reuses caller provided typed arrays across calls', () => {
+      const out = new Float32Array(3)
+      bindings.function.scaleInto(new Float32Array([1, 2, 3]), 2, out)
+      expect(
+        bindings.function.scaleInto(new Float32Array([4, 5, 6]), 2, out)
+      ).to.eq(out)
+      expect(out).to.eql(new Float32Array([8, 10, 12]))
+
+      const bytes = new Uint8Array([1, 2])
+      expect(bindings.function.outUntouched(bytes)).to.eq(bytes)
+      expect(bindings.function.outUntouched()).to.eql(new Uint8Array(0))
+      expect(() => bindings.function.outUntouched([1, 2])).to.throw(TypeError)
+    })
+
+    it('maps files into array buffers', () => {
+      const source = fs.readFileSync(__filename)
+      const mapped = bindings.function.mapFile(__filename)
+      expect(mapped).to.be.instanceOf(Uint8Array)
+      expect(Buffer.from(mapped).equals(source)).to.eq(true)
+
+      const slice = bindings.function.mapFile(__filename, 6, 7)
+      expect(Buffer.from(slice).toString()).to.eq(
+        source.subarray(6, 13).toString()
+      )
+      expect(bindings.function.mapFile(__filename, 1 << 30).byteLength).to.eq(0)
+      expect(() => bindings.function.mapFile(__filename + '.missing')).to.throw(
+        Error,
+        'failed to open'
+      )
+    })
+
+    it('returns views of one mapping over the same array buffer', () => {
+      const source = fs.readFileSync(__filename)
+      const [a, b, slice] = bindings.function.mapFileTwice(__filename)
+      expect(a).to.not.eq(b)
+      expect(a.buffer).to.eq(b.buffer)
+      expect(slice.buffer).to.eq(a.buffer)
+      expect(slice.byteOffset).to.eq(6)
+      expect(Buffer.from(slice).equals(source.subarray(6, 13))).to.eq(true)
+      expect(Buffer.from(b).equals(source)).to.eq(true)
+    })
+
+    it('returns external strings', () => {
+      expect(bindings.function.externalString('ab', 3)).to.eq('ababab')
+      expect(bindings.function.externalString('h\u00e9', 2)).to.eq(
+        'h\u00e9h\u00e9'
+      )
+      expect(bindings.function.externalString('x', 1 << 20)).to.eq(
+        'x'.repeat(1 << 20)
+      )
+      expect(bindings.function.externalString('', 1)).to.eq('')
+      expect(bindings.function.externalU16String('\u4f60\u597d')).to.eq(
+        '\u4f60\u597d!'
+      )
+    })
+
+    it('returns const references', () => {
+      expect(bindings.function.constRefReturn()).to.eq('by reference')
+    })
+
+    it('throws for unsafe integer numbers', () => {
+      for (const value of [0.5, NaN, Infinity, 2 ** 53, -(2 ** 53), '1']) {
+        expect(() => bindings.function.safeInt64Callback(value)).to.throw(
+          TypeError
+        )
+      }
+      expect(() => bindings.function.safeUint64Callback(-1)).to.throw(TypeError)
+    })
+
+    it('throws for non string argument of string view', () => {
+      expect(() => bindings.function.strViewCallback(1)).to.throw(
+        TypeError,
+        'bad arguments'
+      )
+    })
+
     it('calls function throws', () => {
       expect(bindings.function.functionThrows(11)).to.equal('11')
       expect(() => bindings.function.functionThrows(64)).to.throw(
@@ -165,3 +451,11 @@ forEachBinding(bindings => {
     })
   })
 })
+
+describe('External strings', () => {
+  it('are created by the NAPI_EXPERIMENTAL binding', () => {
+    const binding = require('bindings')('binding_external_strings.node')
+    expect(binding.function.externalStrings).to.eq(true)
+    expect(binding.function.externalString('ab', 3)).to.eq('ababab')
+  })
+})
@@ -65,6 +65,33 @@ naah::AsyncWork<void> AsyncTypedArray(
     cb(std::move(arr));
   };
 }
+
+// counts to count in the int32 at index 0 after writing it at index count
+naah::AsyncWork<uint32_t> AsyncSharedCounter(naah::SharedBuffer buffer,
+                                             uint32_t count) {
+  return [buffer, count]() -> uint32_t {
+    for (uint32_t i = 1; i <= count; i++) {
+      buffer.Store(i, static_cast<int32_t>(i * 10));
+      buffer.Store(0, static_cast<int32_t>(i));
+      buffer.Notify(0);
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return count;
+  };
+}
+
+std::optional<int32_t> SharedStoreLoad(naah::SharedBuffer buffer,
+                                       uint32_t index, int32_t value) {
+  if (!buffer.Store(index, value)) {
+    return std::nullopt;
+  }
+  return buffer.Load(index);
+}
+
+naah::SharedBuffer NewSharedBuffer(const Napi::CallbackInfo &info,
+                                   uint32_t size) {
+  return naah::SharedBuffer::New(info.Env(), size);
+}
 }  // namespace
 
 Napi::Object InitMultithread(Napi::Env env) {
@@ -81,5 +108,10 @@ Napi::Object InitMultithread(Napi::Env env) {
   obj["asyncArrayBuffer"] = naah::details::Function::New<AsyncArrayBuffer>(env);
   obj["asyncTypedArray"] = naah::details::Function::New<AsyncTypedArray>(env);
 
+  obj["asyncSharedCounter"] =
+      naah::details::Function::New<AsyncSharedCounter>(env);
+  obj["newSharedBuffer"] = naah::details::Function::New<NewSharedBuffer>(env);
+  obj["sharedStoreLoad"] = naah::details::Function::New<SharedStoreLoad>(env);
+
   return obj;
 }
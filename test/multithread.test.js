@@ -60,5 +60,30 @@ forEachBinding(({ multithread }) => {
         done()
       })
     })
+
+    it('streams into shared buffers', async () => {
+      const buffer = multithread.newSharedBuffer(4 * 6)
+      expect(buffer).to.be.instanceOf(SharedArrayBuffer)
+      expect(buffer.byteLength).to.eq(4 * 6)
+
+      const view = new Int32Array(buffer)
+      const done = multithread.asyncSharedCounter(buffer, 5)
+      let seen = 0
+      while (seen < 5) {
+        await Atomics.waitAsync(view, 0, seen).value
+        seen = Atomics.load(view, 0)
+        expect(view[seen]).to.eq(seen * 10)
+      }
+      expect(await done).to.eq(5)
+      expect(() => multithread.asyncSharedCounter(new ArrayBuffer(8), 1)).to
+        .throw(TypeError)
+    })
+
+    it('checks bounds of shared buffer accesses', () => {
+      const buffer = new SharedArrayBuffer(8)
+      expect(multithread.sharedStoreLoad(buffer, 1, 7)).to.eq(7)
+      expect(new Int32Array(buffer)[1]).to.eq(7)
+      expect(multithread.sharedStoreLoad(buffer, 2, 7)).to.eq(undefined)
+    })
   })
 })
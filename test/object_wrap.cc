@@ -1,6 +1,15 @@
 #include <naah.h>
 
 namespace {
+// counts the copies and moves since it was converted
+struct Tracked {
+  Tracked() = default;
+  Tracked(const Tracked& other) : transfers(other.transfers + 1) {}
+  Tracked(Tracked&& other) : transfers(other.transfers + 1) {}
+
+  uint32_t transfers = 0;
+};
+
 class TestObject : public naah::Class {
  public:
   TestObject(uint32_t num) : _num(num) {}
@@ -17,6 +26,10 @@ class TestObject : public naah::Class {
     return info.Length();
   }
 
+  uint32_t Transfers(Tracked t) { return t.transfers; }
+
+  uint32_t ConstTransfers(Tracked t) const { return t.transfers; }
+
   std::string SymMethod(std::string str) { return str + "??sym"; }
 
   static void AddStatic(uint32_t c) { _count += c; }
@@ -40,6 +53,15 @@ class AnotherTestObject : public naah::Class {
 };
 }  // namespace
 
+namespace naah {
+template <>
+struct ValueTransformer<Tracked> {
+  static std::optional<Tracked> FromJS(Napi::Value) {
+    return std::make_optional<Tracked>();
+  }
+};
+}  // namespace naah
+
 NAAH_REGISTRATION {
   naah::Registration::Class<TestObject>("TestObject")
       .Constructor<uint32_t>()
@@ -49,6 +71,8 @@ NAAH_REGISTRATION {
       .InstanceMethod<&TestObject::Multiply>("multiply")
       .InstanceMethod<&TestObject::Add>("add")
       .InstanceMethod<&TestObject::GetArgLength>("getArgLength")
+      .InstanceMethod<&TestObject::Transfers>("transfers")
+      .InstanceMethod<&TestObject::ConstTransfers>("constTransfers")
       .InstanceAccessor<&TestObject::num>("readonlyNum")
       .InstanceAccessor<&TestObject::num, &TestObject::set_num>("num");
 
@@ -22,6 +22,13 @@ forEachBinding(({ scriptWrappable }) => {
       expect(obj.getArgLength(0, 1, 2)).to.eq(3)
     })
 
+    it('moves method arguments at most once', () => {
+      const obj = new scriptWrappable.TestObject(233)
+
+      expect(obj.transfers(0)).to.eq(1)
+      expect(obj.constTransfers(0)).to.eq(1)
+    })
+
     it('calls instance accessor', () => {
       const obj = new scriptWrappable.TestObject(233)
       expect(obj.num).to.eq(233)
@@ -2,10 +2,38 @@
 #include <naah_friend.h>
 
 #include <iostream>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
 
 namespace {
 uint32_t Add(uint32_t a, uint32_t b) { return a + b; }
 
+// rows seen by the batch functions below, which throw on odd numbers
+uint32_t batch_rows = 0;
+
+uint32_t Halve(const Napi::CallbackInfo &info, uint32_t n) {
+  batch_rows++;
+  if (n % 2 != 0) {
+    Napi::RangeError::New(info.Env(), "odd").ThrowAsJavaScriptException();
+  }
+  return n / 2;
+}
+
+void CheckEven(const Napi::CallbackInfo &info, uint32_t n) {
+  batch_rows++;
+  if (n % 2 != 0) {
+    Napi::RangeError::New(info.Env(), "odd").ThrowAsJavaScriptException();
+  }
+}
+
+uint32_t TakeBatchRows() { return std::exchange(batch_rows, 0); }
+
+double Mix(int8_t a, bool b, float c, int64_t d) {
+  return b ? a + c + static_cast<double>(d) : 0;
+}
+
 class Calculator : public naah::Class {
   uint32_t _num;
   Calculator(uint32_t num) : _num(num) {}
@@ -37,6 +65,37 @@ class Calculator : public naah::Class {
 
 uint32_t Calculator::_count = 0;
 
+// context parameters are supplied to constructors and instance methods too
+class Counter : public naah::Class {
+  uint32_t _num;
+  Counter(Napi::Env env, uint32_t num, naah::StopToken token)
+      : _num(env.Global().IsObject() && !token.stop_requested() ? num : 0) {}
+
+  uint32_t add(naah::StopToken token, uint32_t a, Napi::Env env) {
+    if (env.Global().IsObject() && !token.stop_requested()) {
+      _num += a;
+    }
+    return _num;
+  }
+
+  NAAH_FRIEND
+};
+
+// tokens outlive the env they were taken from, and see it torn down
+std::mutex stop_tokens_mutex;
+std::vector<naah::StopToken> stop_tokens;
+
+uint32_t KeepStopToken(naah::StopToken token) {
+  std::lock_guard<std::mutex> lock(stop_tokens_mutex);
+  stop_tokens.push_back(std::move(token));
+  return static_cast<uint32_t>(stop_tokens.size() - 1);
+}
+
+bool KeptStopRequested(uint32_t i) {
+  std::lock_guard<std::mutex> lock(stop_tokens_mutex);
+  return stop_tokens.at(i).stop_requested();
+}
+
 struct MyObject : naah::Object {
   std::string str;
   std::optional<uint32_t> num;
@@ -50,8 +109,72 @@ MyObject MyObjectMethod(MyObject input) {
                       : std::nullopt};
 }
 
+struct Samples : naah::Object {
+  std::vector<double> values;
+  std::string unit;
+};
+
+struct Tagged : naah::Object {
+  std::vector<double> values;
+  uint32_t tag;
+};
+
+std::string DescribeSamples(std::variant<Samples, Tagged> input) {
+  if (auto *samples = std::get_if<Samples>(&input)) {
+    return std::to_string(samples->values.size()) + " " + samples->unit;
+  }
+  return "tag " + std::to_string(std::get<Tagged>(input).tag);
+}
+
+struct Point : naah::Object {
+  float x;
+  float y;
+  float z;
+  uint32_t id;
+};
+
+naah::StructArray<Point> MovePoints(naah::StructArray<Point> points,
+                                    float dx) {
+  for (Point &p : points) {
+    p.x += dx;
+    p.id += 1;
+  }
+  return points;
+}
+
+class Blob : public naah::Class {
+ public:
+  Blob(uint32_t size) : _data(size) {}
+
+  size_t external_memory() const { return _data.capacity(); }
+
+  uint32_t size() const { return _data.size(); }
+
+ private:
+  std::vector<char> _data;
+};
+
+// the unused capacity is reported on top of the byte length V8 accounts
+// what napi_adjust_external_memory reported in total, which
+// process.memoryUsage() doesn't include
+double ExternalMemory(Napi::Env env) {
+  int64_t value = 0;
+  napi_adjust_external_memory(env, 0, &value);
+  return static_cast<double>(value);
+}
+
+naah::ArrayBuffer ReservedBuffer(uint32_t size, uint32_t capacity) {
+  naah::ArrayBuffer buffer;
+  buffer.reserve(capacity);
+  buffer.resize(size);
+  return buffer;
+}
+
 class FactorOnlyObject : public naah::Class {
   static FactorOnlyObject create() { return FactorOnlyObject(); }
+  static std::vector<FactorOnlyObject> createMany(uint32_t count) {
+    return std::vector<FactorOnlyObject>(count);
+  }
 
   NAAH_FRIEND
 };
@@ -86,6 +209,9 @@ class SubA : public Base {
   }
 
   static uint32_t AcceptA(SubA* a) { return a->_num; }
+  static uint32_t AcceptOptionalA(std::optional<SubA*> a) {
+    return a ? (*a)->_num : 0;
+  }
 };
 
 class SubB : public Base {
@@ -101,20 +227,83 @@ class SubB : public Base {
 
   static uint32_t AcceptB(SubB* b) { return b->_num; }
 };
+
+enum class Status { kIdle, kRunning, kDone, kFailed = -1 };
+
+Status NextStatus(Status status) {
+  return status == Status::kIdle ? Status::kRunning : Status::kDone;
+}
+
+naah::InternedString StatusText() {
+  return NAAH_INTERNED_STRING("running fine");
+}
+
+// each expression reserves one slot, however often it's evaluated
+bool InternedSlotsReserved() {
+  auto shared = [] { return NAAH_INTERNED_STRING("shared"); };
+  return shared().slot() == shared().slot() &&
+         shared().slot() != NAAH_INTERNED_STRING("shared").slot();
+}
+
+// values too far apart to be indexed by a table
+enum class Sparse : int64_t { kLow = -(int64_t{1} << 40), kHigh = 1 << 20 };
+
+Sparse FlipSparse(Sparse sparse) {
+  return sparse == Sparse::kLow ? Sparse::kHigh : Sparse::kLow;
+}
 }  // namespace
 
+namespace naah {
+template <>
+struct Enum<Status> {
+  static constexpr EnumValue<Status> values[] = {{Status::kIdle, "idle"},
+                                                 {Status::kRunning, "running"},
+                                                 {Status::kDone, "done"},
+                                                 {Status::kFailed, "失败"}};
+};
+
+template <>
+struct Enum<Sparse> {
+  static constexpr EnumValue<Sparse> values[] = {{Sparse::kHigh, "high"},
+                                                 {Sparse::kLow, "low"}};
+};
+}  // namespace naah
+
 NAAH_REGISTRATION {
   using reg = naah::Registration;
 
+#ifdef NAAH_TEST_LAZY_CLASSES
+  reg::LazyClasses();
+#endif
+
   reg::Value("num", 233);
   reg::Value("str", "hello world");
   reg::Function("add",
                 [](uint32_t a, uint32_t b) -> uint32_t { return a + b; });
   reg::Function<Add>("addTpl");
+  reg::BatchFunction<Add>("addBatch");
+  reg::BatchFunction<Halve>("halveBatch");
+  reg::BatchFunction<CheckEven>("checkEvenBatch");
+  reg::Function<TakeBatchRows>("takeBatchRows");
+  reg::FastFunction<Add>("addFast");
+  reg::FastFunction<Mix>("mixFast");
 
   reg::Object<MyObject>().Member<&MyObject::num>("num").Member<&MyObject::str>(
       "str");
   reg::Function<MyObjectMethod>("myObjectMethod");
+  reg::Object<Samples>()
+      .Member<&Samples::values>("values")
+      .Member<&Samples::unit>("unit");
+  reg::Object<Tagged>().Member<&Tagged::values>("values").Member<&Tagged::tag>(
+      "tag");
+  reg::Function<DescribeSamples>("describeSamples");
+  reg::Object<Point>()
+      .Member<&Point::x>("x")
+      .Member<&Point::y>("y")
+      .Member<&Point::z>("z")
+      .Member<&Point::id>("id");
+  reg::Value("pointLayout", naah::StructLayout<Point>());
+  reg::Function<MovePoints>("movePoints");
 
   reg::Class<Calculator>("Calculator")
       .Constructor<uint32_t>()
@@ -126,8 +315,31 @@ NAAH_REGISTRATION {
       .StaticAccessor<&Calculator::count, &Calculator::set_count>("count")
       .StaticAccessor<&Calculator::count>("readonlyCount");
 
+  reg::Class<Counter>("Counter")
+      .Constructor<Napi::Env, uint32_t, naah::StopToken>()
+      .InstanceMethod<&Counter::add>("add");
+  reg::Function<KeepStopToken>("keepStopToken");
+  reg::Function<KeptStopRequested>("keptStopRequested");
+
+  reg::Class<Blob>("Blob")
+      .Constructor<uint32_t>()
+      .ExternalMemory<&Blob::external_memory>()
+      .InstanceAccessor<&Blob::size>("size");
+  reg::Function("createBlob", [](uint32_t size) { return Blob(size); });
+  reg::Function("createBlobs", [](uint32_t size, uint32_t count) {
+    return std::optional<std::vector<Blob>>(std::vector<Blob>(count, size));
+  });
+  reg::Function<ReservedBuffer>("reservedBuffer");
+  reg::Function<ExternalMemory>("externalMemory");
+
+  reg::Function<NextStatus>("nextStatus");
+  reg::Function<StatusText>("statusText");
+  reg::Function<InternedSlotsReserved>("internedSlotsReserved");
+  reg::Function<FlipSparse>("flipSparse");
+
   reg::Class<FactorOnlyObject>("FactorOnlyObject")
       .StaticMethod<&FactorOnlyObject::create>("create");
+  reg::Function<&FactorOnlyObject::createMany>("createFactorOnlyObjects");
 
   reg::Class<Base>("Base")
       .InstanceMethod<&Base::GetReal>("getReal")
@@ -138,7 +350,8 @@ NAAH_REGISTRATION {
       .Inherits<Base>()
       .Constructor<uint32_t>()
       .InstanceMethod<&SubA::Sub>("sub")
-      .StaticMethod<SubA::AcceptA>("acceptA");
+      .StaticMethod<SubA::AcceptA>("acceptA")
+      .StaticMethod<SubA::AcceptOptionalA>("acceptOptionalA");
   reg::Class<SubB>("SubB")
       .Inherits<Base>()
       .Constructor<uint32_t>()
@@ -1,5 +1,12 @@
 const { expect } = require('chai')
 const bindings = require('bindings')
+const v8 = require('v8')
+const vm = require('vm')
+const { Worker } = require('worker_threads')
+
+// collects garbage of earlier tests before measuring external memory
+v8.setFlagsFromString('--expose-gc')
+const gc = vm.runInNewContext('gc')
 
 const cb = (binding) => {
   describe('Registration', () => {
@@ -16,6 +23,66 @@ const cb = (binding) => {
       expect(binding.addTpl(1, 2)).to.eq(3)
     })
 
+    it('register fast function', () => {
+      expect(binding.addFast(1, 2)).to.eq(3)
+      expect(binding.addFast(2 ** 32 - 1, 2)).to.eq(1)
+      expect(binding.addFast.name).to.eq('addFast')
+      expect(binding.mixFast(-2, true, 0.5, 10n)).to.eq(8.5)
+      expect(binding.mixFast(-2, false, 0.5, 10n)).to.eq(0)
+      expect(() => binding.addFast('a', 1)).to.throw(TypeError, 'bad arguments')
+      expect(() => binding.addFast(1)).to.throw(TypeError, 'bad arguments')
+      expect(() => binding.mixFast(-2, 1, 0.5, 10n)).to.throw(
+        TypeError,
+        'bad arguments'
+      )
+    })
+
+    it('register batch function', () => {
+      expect(binding.addBatch([[1, 2], [3, 4]])).to.eql([3, 7])
+      expect(binding.addBatch([])).to.eql([])
+      expect(
+        binding.addBatch(new Uint32Array([1, 3]), new Uint32Array([2, 4]))
+      ).to.eql(new Uint32Array([3, 7]))
+      expect(() => binding.addBatch([[1, 2], [3, 'a']])).to.throw(
+        TypeError,
+        'bad arguments at index 1'
+      )
+      expect(() => binding.addBatch([[1, 2], 3])).to.throw(
+        TypeError,
+        'bad arguments at index 1'
+      )
+      expect(() =>
+        binding.addBatch(new Uint32Array(2), new Int32Array(2))
+      ).to.throw(TypeError, 'bad column at index 1')
+      expect(() =>
+        binding.addBatch(new Uint32Array(2), new Uint32Array(3))
+      ).to.throw(TypeError, 'bad column at index 1')
+    })
+
+    it('stops batch calls at the first thrown error', () => {
+      binding.takeBatchRows()
+      expect(() => binding.halveBatch([[2], [3], [4]])).to.throw(
+        RangeError,
+        'odd'
+      )
+      expect(binding.takeBatchRows()).to.eq(2)
+      expect(() => binding.checkEvenBatch([[2], [3], [4]])).to.throw(
+        RangeError,
+        'odd'
+      )
+      expect(binding.takeBatchRows()).to.eq(2)
+      expect(() => binding.halveBatch(new Uint32Array([2, 3, 4]))).to.throw(
+        RangeError,
+        'odd'
+      )
+      expect(binding.takeBatchRows()).to.eq(2)
+      expect(() =>
+        binding.checkEvenBatch(new Uint32Array([2, 3, 4]))
+      ).to.throw(RangeError, 'odd')
+      expect(binding.takeBatchRows()).to.eq(2)
+      expect(binding.halveBatch([[2], [4]])).to.eql([1, 2])
+    })
+
     it('register custom object', () => {
       expect(binding.myObjectMethod({ str: 'hello' })).to.eql({
         str: 'hello world'
@@ -27,6 +94,69 @@ const cb = (binding) => {
       expect(() => binding.myObjectMethod({})).to.throw(TypeError)
     })
 
+    it('picks object variants without converting rejected ones', () => {
+      let reads = 0
+      const values = [1, 2, 3]
+      Object.defineProperty(values, 0, {
+        get () {
+          reads++
+          return 1
+        }
+      })
+      expect(binding.describeSamples({ values, unit: 'ms' })).to.eq('3 ms')
+      expect(reads).to.eq(1)
+      expect(binding.describeSamples({ values, tag: 7 })).to.eq('tag 7')
+      expect(reads).to.eq(2)
+      expect(() => binding.describeSamples({ values, tag: 'x' })).to.throw(
+        TypeError
+      )
+      expect(reads).to.eq(2)
+    })
+
+    it('reads each field once per tried alternative', () => {
+      let reads = 0
+      const input = {
+        get values () {
+          reads++
+          return [1, 2]
+        },
+        unit: 'ms'
+      }
+      expect(binding.describeSamples(input)).to.eq('2 ms')
+      expect(reads).to.eq(1)
+    })
+
+    it('transfers struct arrays in one buffer', () => {
+      const { stride, littleEndian, fields } = binding.pointLayout
+      expect(stride).to.eq(16)
+      expect(fields).to.eql({
+        x: { offset: 0, type: 'Float32' },
+        y: { offset: 4, type: 'Float32' },
+        z: { offset: 8, type: 'Float32' },
+        id: { offset: 12, type: 'Uint32' }
+      })
+
+      const input = new DataView(new ArrayBuffer(2 * stride))
+      for (let i = 0; i < 2; i++) {
+        input.setFloat32(i * stride + fields.x.offset, i + 0.5, littleEndian)
+        input.setUint32(i * stride + fields.id.offset, i * 10, littleEndian)
+      }
+      const output = new DataView(binding.movePoints(input, 1))
+      expect(output.byteLength).to.eq(2 * stride)
+      for (let i = 0; i < 2; i++) {
+        expect(output.getFloat32(i * stride, littleEndian)).to.eq(i + 1.5)
+        expect(output.getUint32(i * stride + 12, littleEndian)).to.eq(
+          i * 10 + 1
+        )
+      }
+
+      expect(new Float32Array(binding.movePoints(new Float32Array(4), 2)))
+        .to.have.length(4)
+      expect(() => binding.movePoints(new ArrayBuffer(10), 0)).to.throw(
+        TypeError
+      )
+    })
+
     it('register class', () => {
       const calculator = new binding.Calculator(1)
       expect(calculator.num).to.eq(1)
@@ -42,6 +172,36 @@ const cb = (binding) => {
       expect(calculator.readonlyNum).to.eq(42)
     })
 
+    it('register class taking context parameters', () => {
+      const counter = new binding.Counter(1)
+      expect(counter.add(2)).to.eq(3)
+      expect(counter.add(4, 5)).to.eq(7)
+      expect(() => new binding.Counter()).to.throw(TypeError)
+      expect(() => counter.add()).to.throw(TypeError)
+    })
+
+    it('stops tokens when their env is torn down', done => {
+      const kept = binding.keepStopToken()
+      const file = Object.keys(require.cache).find(
+        key => require.cache[key].exports === binding
+      )
+      const worker = new Worker(
+        `const { parentPort, workerData } = require('worker_threads')
+        parentPort.postMessage(require(workerData).keepStopToken())`,
+        { eval: true, workerData: file }
+      )
+      let index
+      worker.on('message', i => {
+        index = i
+      })
+      worker.on('error', done)
+      worker.on('exit', () => {
+        expect(binding.keptStopRequested(index)).to.eq(true)
+        expect(binding.keptStopRequested(kept)).to.eq(false)
+        done()
+      })
+    })
+
     it('register class static', () => {
       const { Calculator } = binding
 
@@ -65,6 +225,56 @@ const cb = (binding) => {
       expect(calculator.add(2)).to.eq(3)
     })
 
+    it('return class instances in containers', () => {
+      const blobs = binding.createBlobs(8, 3)
+      expect(blobs).to.have.lengthOf(3)
+      for (const blob of blobs) {
+        expect(blob).to.be.instanceOf(binding.Blob)
+        expect(blob.size).to.eq(8)
+      }
+    })
+
+    it('register class with external memory', () => {
+      expect(new binding.Blob(1024).size).to.eq(1024)
+      for (let i = 0; i < 64; ++i) {
+        expect(new binding.Blob(1 << 20).size).to.eq(1 << 20)
+      }
+
+      gc()
+      const before = binding.externalMemory()
+      const blobs = Array.from({ length: 16 }, () => new binding.Blob(1 << 20))
+      const after = binding.externalMemory()
+      expect(blobs).to.have.lengthOf(16)
+      expect(after - before).to.be.at.least(16 << 20)
+    })
+
+    it('reports external memory of returned buffers', () => {
+      gc()
+      const before = binding.externalMemory()
+      const buffer = binding.reservedBuffer(1 << 20, 8 << 20)
+      const after = binding.externalMemory()
+      expect(buffer.byteLength).to.eq(1 << 20)
+      // V8 counts the byte length itself, the rest is reported
+      expect(after - before).to.be.at.least(7 << 20)
+    })
+
+    it('register enum', () => {
+      expect(binding.nextStatus('idle')).to.eq('running')
+      expect(binding.nextStatus(binding.nextStatus('idle'))).to.eq('done')
+      expect(binding.nextStatus('失败')).to.eq('done')
+      for (const value of ['runnin', 'running!', 'Idle', '', 'd\u00f6ne', 0]) {
+        expect(() => binding.nextStatus(value)).to.throw(TypeError)
+      }
+      expect(binding.flipSparse('low')).to.eq('high')
+      expect(binding.flipSparse('high')).to.eq('low')
+    })
+
+    it('return interned string', () => {
+      expect(binding.statusText()).to.eq('running fine')
+      expect(binding.statusText()).to.eq('running fine')
+      expect(binding.internedSlotsReserved()).to.eq(true)
+    })
+
     it('throws error for new in factory only class', () => {
       expect(() => new binding.FactorOnlyObject()).to.throw()
       expect(binding.FactorOnlyObject.create()).to.be.instanceOf(binding.FactorOnlyObject)
@@ -105,12 +315,106 @@ const cb = (binding) => {
       expect(() => binding.Base.getReal({})).to.throw(TypeError)
       expect(binding.SubA.acceptA(a)).to.eq(42)
       expect(() => binding.SubA.acceptA(b)).to.throw(TypeError)
+      expect(() => binding.SubA.acceptA(undefined)).to.throw(TypeError)
+      expect(() => binding.SubA.acceptA(null)).to.throw(TypeError)
+      expect(binding.SubA.acceptOptionalA(a)).to.eq(42)
+      expect(binding.SubA.acceptOptionalA()).to.eq(0)
+      expect(binding.SubA.acceptOptionalA(undefined)).to.eq(0)
+      expect(binding.SubA.acceptOptionalA(null)).to.eq(0)
       expect(binding.SubB.acceptB(b)).to.eq(468)
       expect(() => binding.SubB.acceptB(a)).to.throw(TypeError)
     })
+
+    it('chains subclass prototypes without copying members', () => {
+      const { Base, SubA, SubB } = binding
+      expect(Object.getPrototypeOf(SubA.prototype)).to.eq(Base.prototype)
+      expect(Object.getPrototypeOf(SubB.prototype)).to.eq(Base.prototype)
+      expect(Object.getPrototypeOf(SubA)).to.eq(Base)
+      expect(Object.getPrototypeOf(SubB)).to.eq(Base)
+
+      expect(Object.getOwnPropertyNames(SubA.prototype).sort()).to.eql(['constructor', 'sub'])
+      expect(Object.prototype.hasOwnProperty.call(SubA, 'getReal')).to.eq(false)
+      expect(new SubA(1).add).to.eq(Base.prototype.add)
+      expect(Object.getOwnPropertySymbols(Base.prototype)).to.eql([])
+      expect(SubA.prototype.sub.name).to.eq('sub')
+    })
+
+    it('rejects subclass members on foreign receivers', () => {
+      const a = new binding.SubA(42)
+      const b = new binding.SubB(233)
+      expect(() => binding.SubA.prototype.sub.call(b, 1)).to.throw(TypeError, 'Illegal invocation')
+      expect(() => binding.SubA.prototype.sub.call({}, 1)).to.throw(TypeError, 'Illegal invocation')
+      expect(() => binding.Base.prototype.add.call({}, 1)).to.throw(TypeError)
+      const num = Object.getOwnPropertyDescriptor(binding.Base.prototype, 'num')
+      expect(() => num.get.call(new binding.Calculator(1))).to.throw(TypeError, 'Illegal invocation')
+      expect(binding.SubA.prototype.sub.call(a, 2)).to.eq(40)
+    })
+
+    it('supports extending exported classes in JavaScript', () => {
+      class SubC extends binding.SubA {
+        twice () {
+          return this.num * 2
+        }
+      }
+      const c = new SubC(21)
+      expect(c).to.be.instanceOf(binding.SubA)
+      expect(c.twice()).to.eq(42)
+      expect(c.getReal()).to.eq('A')
+      expect(c.sub(1)).to.eq(20)
+      expect(binding.SubA.acceptA(c)).to.eq(20)
+    })
+
+    it('requires new for subclasses', () => {
+      expect(() => binding.SubA(1)).to.throw(TypeError, "Class constructors cannot be invoked without 'new'")
+    })
   })
 }
 
+describe('Lazy Classes', () => {
+  const binding = bindings('registration_lazy.node')
+
+  const isDefined = (name) =>
+    Object.getOwnPropertyDescriptor(binding, name).get === undefined
+
+  it('defines class on first access', () => {
+    expect(Object.keys(binding)).to.include('Calculator')
+    expect(isDefined('Calculator')).to.eq(false)
+    const Calculator = binding.Calculator
+    expect(isDefined('Calculator')).to.eq(true)
+    expect(binding.Calculator).to.eq(Calculator)
+    expect(new Calculator(1).add(2)).to.eq(3)
+  })
+
+  it('defines class of returned value', () => {
+    expect(isDefined('Blob')).to.eq(false)
+    const blob = binding.createBlob(16)
+    expect(isDefined('Blob')).to.eq(true)
+    expect(blob).to.be.instanceOf(binding.Blob)
+    expect(blob.size).to.eq(16)
+  })
+
+  it('defines class of values returned in containers', () => {
+    expect(isDefined('FactorOnlyObject')).to.eq(false)
+    const objects = binding.createFactorOnlyObjects(2)
+    expect(isDefined('FactorOnlyObject')).to.eq(true)
+    expect(objects[0]).to.be.instanceOf(binding.FactorOnlyObject)
+    expect(objects[1]).to.be.instanceOf(binding.FactorOnlyObject)
+  })
+
+  it('defines parent class before subclass', () => {
+    expect(isDefined('Base')).to.eq(false)
+    expect(isDefined('SubB')).to.eq(false)
+    const SubB = binding.SubB
+    expect(isDefined('Base')).to.eq(true)
+    expect(isDefined('SubA')).to.eq(false)
+    expect(Object.getPrototypeOf(SubB)).to.eq(binding.Base)
+    expect(new SubB(3).mul(2)).to.eq(6)
+    expect(new binding.SubA(3).sub(1)).to.eq(2)
+  })
+
+  cb(binding)
+})
+
 describe('Exception', () => {
   cb(bindings('registration.node'))
 })